@@ -2,11 +2,25 @@
 #define BUS_H
 #pragma once
 #include <vector>
+#include <deque>
+#include <string>
 #include <cstdint>
 #include "Cache.hh"
+#include "EventLog.hh"
+#include "SharingTracker.hh"
+#include "L2Cache.hh"
 
 class Core;
 
+// Cycles to read or write a block in memory
+const uint64_t MEMORY_LATENCY = 100;
+
+// Which waiting request gets the bus once it frees up
+enum Arbitration {
+    ARBITRATION_RETRY,  // Lowest-numbered core first, as if every waiter retried each cycle
+    ARBITRATION_FIFO    // Oldest request first, in the order the requests were generated
+};
+
 class Bus {
 public:
     Bus();
@@ -16,7 +30,9 @@ public:
         NO_DATA,        // No cache has the data
         SHARED_DATA,    // Data found in another cache (shared)
         EXCLUSIVE_DATA,  // Data found in exclusive state 
-        MODIFIED_DATA   // Data found in modified state (needs writeback)
+        MODIFIED_DATA,  // Data found in modified state (needs writeback)
+        OWNED_DATA,     // Data found in owned state (MOESI)
+        FORWARD_DATA    // Data found in forward state (MESIF)
     };
     
     // Statistics
@@ -27,8 +43,39 @@ public:
     uint64_t freeCycle;
     bool moreleft;
     uint64_t coreid;
+    bool prefetchTenure;    // The bus is held by a prefetch fill
+    
+    EventLog* eventLog;     // Optional coherence event log (not owned)
+    SharingTracker* sharing;    // Optional false-sharing detector (not owned)
+    L2Cache* l2;            // Optional shared L2 in front of memory (not owned)
+    Arbitration arbitration;
+    
+    // A queued bus request: a parked core retrying its current access, or a miss
+    // a non-blocking cache has already retired into one of its MSHRs
+    struct Waiter {
+        int coreId;
+        int mshr;       // MSHR slot, or -1 for a parked core
+    };
+    
+    // Arbitration queue, in the order the requests were generated
+    std::deque<Waiter> waitQueue;
+
+    // Park a core that found the bus busy; it is not polled again until granted
+    void requestBus(int coreId, uint64_t cycle, std::vector<Core*>& cores);
     
-    // Store the instrucion in bus
+    // Queue the transaction for a core's MSHR; the core itself keeps running
+    void queueMiss(int coreId, int mshr, uint64_t cycle, std::vector<Core*>& cores);
+    
+    // Pop the oldest waiter, charging a parked core its idle time in bulk; coreId is -1 if none
+    Waiter grantBus(uint64_t cycle, std::vector<Core*>& cores);
+    
+    // Same, but only considering the waiters of one core (retry arbitration)
+    Waiter grantBus(uint64_t cycle, std::vector<Core*>& cores, int coreId);
+    
+    // Take a parked core out of the queue without a grant, charging its idle time so far
+    void unpark(int coreId, uint64_t cycle, std::vector<Core*>& cores);
+    
+    bool hasWaiters() const { return !waitQueue.empty(); }
 
 
     // Bus read (for read misses)
@@ -40,6 +87,25 @@ public:
     // Bus upgrade (for write to shared line)
     void busUpgrade(int requesterId, uint32_t address, std::vector<Core*>& cores, int s, int b);
     
+    // Latency of the level below the L1s: the L2 if there is one, else memory.
+    // Both keep the L2 up to date and back-invalidate the L1 copies of its victims.
+    uint64_t fetchBlock(uint32_t address, uint64_t cycle, std::vector<Core*>& cores);      // Fill for an L1 miss
+    uint64_t writeBackBlock(uint32_t address);  // Dirty L1 block
+    
+    // Whether fetching the block would make the L2 evict one still held by some L1
+    bool fetchWouldBackInvalidate(uint32_t address, std::vector<Core*>& cores) const;
+    
+private:
+    // Charges a demand request the rest of a prefetch's tenure it has to wait out
+    void chargePrefetchDelay(Core* core, uint64_t cycle);
+    Waiter grant(std::deque<Waiter>::iterator it, uint64_t cycle, std::vector<Core*>& cores);
+    // Removes every L1 copy of an L2 victim; returns the latency of writing it to memory
+    uint64_t backInvalidate(L2Victim& victim, uint64_t cycle, std::vector<Core*>& cores);
+    
 };
 
+// Parses "retry" or "fifo"; false if unrecognised
+bool parseArbitration(const std::string& name, Arbitration& arbitration);
+const char* arbitrationName(Arbitration arbitration);
+
 #endif // BUS_H
@@ -4,15 +4,28 @@
 #pragma once
 #include <vector>
 #include <cstdint>
-#include <unordered_map>
-#include <list>
+#include <utility>
+#include "MissClassifier.hh"
+#include "TagMatch.hh"
+#include "EventLog.hh"
+#include "Prefetcher.hh"
 
-// MESI protocol states
+// Coherence states; OWNED is used by MOESI and FORWARD by MESIF only
 enum CacheState {
     MODIFIED,
     EXCLUSIVE,
     SHARED,
-    INVALID
+    INVALID,
+    OWNED,
+    FORWARD,
+    NUM_CACHE_STATES
+};
+
+// Coherence protocol selected for a run (see Protocol.hh)
+enum ProtocolKind {
+    PROTOCOL_MESI,
+    PROTOCOL_MOESI,
+    PROTOCOL_MESIF
 };
 
 struct CacheLine {
@@ -20,47 +33,52 @@ struct CacheLine {
     CacheState state;
     uint32_t tag;
     uint64_t lastUsedCycle;
+    uint64_t lruStamp;      // Larger is more recently used
+    bool prefetched;        // Filled by the prefetcher and not yet used by a demand access
+    uint64_t readyCycle;    // Cycle at which the block's data arrives
+    
+    CacheLine() : valid(false), state(INVALID), tag(0), lastUsedCycle(0), lruStamp(0),
+                  prefetched(false), readyCycle(0) {}
+};
+
+// One outstanding miss of a non-blocking cache
+struct MshrEntry {
+    bool busy;              // Slot holds an outstanding miss
+    bool issued;            // Transaction has been on the bus; readyCycle is known
+    bool isWrite;           // Needs ownership (a merged write upgrades a queued read)
+    uint32_t address;
+    uint64_t allocCycle;
+    uint64_t readyCycle;
+    MissType missType;      // Classification of the primary miss, shared by merged ones
     
-    CacheLine() : valid(false), state(INVALID), tag(0), lastUsedCycle(0) {}
+    MshrEntry() : busy(false), issued(false), isWrite(false), address(0), allocCycle(0), readyCycle(0),
+                  missType(COMPULSORY_MISS) {}
 };
 
-// Cache key structure for map lookup
+// Identifies a line by set and tag
 struct CacheKey {
     uint32_t setIndex;
     uint32_t tag;
     
     // Constructor
     CacheKey(uint32_t s, uint32_t t) : setIndex(s), tag(t) {}
-    
-    // Equality operator for map
-    bool operator==(const CacheKey& other) const {
-        return setIndex == other.setIndex && tag == other.tag;
-    }
 };
 
-// Hash function for the CacheKey
-namespace std {
-    template<>
-    struct hash<CacheKey> {
-        size_t operator()(const CacheKey& key) const {
-            return hash<uint32_t>()(key.setIndex) ^ hash<uint32_t>()(key.tag);
-        }
-    };
-}
-
 class Cache {
 public:
     int s, E, b;
-    // LRU list to track usage order per set
-    typedef std::list<CacheKey> LRUList;
     
-    // Cache map: stores cache lines and references to their position in the LRU list
-    typedef std::pair<CacheLine, typename LRUList::iterator> CacheEntry;
-    typedef std::unordered_map<CacheKey, CacheEntry> CacheMap;
+    // Set-major line storage: way w of set i lives at lines[i * E + w]
+    std::vector<CacheLine> lines;
+    
+    // Tags mirrored into one aligned row per set (tagStride ways, padded with
+    // EMPTY_TAG) so a whole set is compared by a single tagMatch call
+    int tagStride;
+    uint32_t* tags;
+    TagMatchFn tagMatch;
     
-    // One LRU list and one map per set
-    std::vector<LRUList> lruLists;
-    std::vector<CacheMap> cacheMaps;
+    std::vector<int> setFill;   // Occupied ways per set
+    uint64_t lruClock;          // Source of lruStamp values
     
     // Statistics
     uint64_t readHits;
@@ -72,23 +90,126 @@ public:
     uint64_t evictions;
     uint64_t trafficBytes;
     uint64_t invalidations;
+    uint64_t backInvalidations;     // Lines lost to inclusion victims of the shared L2
+    uint64_t prefetchDelayCycles;   // Cycles our demand misses waited for a prefetch to release the bus
+    
+    // Miss breakdown (sums to readMisses + writeMisses)
+    uint64_t compulsoryMisses;
+    uint64_t capacityMisses;
+    uint64_t conflictMisses;
+    uint64_t coherenceMisses;
+    uint64_t inclusionMisses;   // Only with a shared L2; part of the breakdown then
+    MissClassifier classifier;
+    
+    ProtocolKind protocol;
+    // transitions[from][to] counts every state change of a line in this cache
+    uint64_t transitions[NUM_CACHE_STATES][NUM_CACHE_STATES];
+    
+    Prefetcher* prefetcher;     // Optional, owned by the cache
+    
+    // Non-blocking mode, enabled by a non-empty table: misses retire into an MSHR
+    // and the core keeps going until every MSHR is outstanding
+    std::vector<MshrEntry> mshrs;
+    uint64_t mshrAllocations;
+    uint64_t mshrMerges;        // Secondary misses folded into an outstanding MSHR (counted as misses)
+    uint64_t mshrFullStalls;    // Cycles stalled because every MSHR was outstanding
+    uint64_t mshrBusyCycles;    // Sum of MSHR lifetimes, for average occupancy
+    uint64_t mshrPeak;
+    uint64_t lastFillCycle;     // Latest fill of any MSHR
+
+private:
+    std::vector<uint32_t> tagStorage;   // Backing store for tags (over-allocated for alignment)
+public:
     
-    Cache(int s, int E, int b);
+    Cache(int s, int E, int b, ProtocolKind protocol = PROTOCOL_MESI);
+    ~Cache();
+    Cache(const Cache&) = delete;
+    Cache& operator=(const Cache&) = delete;
     
-    // Core cache operations
+    // Core cache operations; dispatches to the policy for this cache's protocol
     void accessCache(bool isWrite, uint32_t address, uint64_t cycle, int coreId,
                     class Bus& bus, std::vector<class Core*>& cores);
     
-    // Map-based cache operations
+    // Changes a line's state and counts the transition
+    void setState(CacheLine& line, CacheState next);
+    
+    // Puts a queued MSHR miss on the bus once it has been granted
+    void issueMshr(int slot, uint64_t cycle, int coreId, class Bus& bus, std::vector<class Core*>& cores);
+    
+    // Frees every MSHR at the end of the run; returns the cycles spent waiting past lastCycle
+    uint64_t drainMshrs(uint64_t lastCycle);
+    
+    // Whether an access would have to go to the bus (a miss, or a write that must
+    // invalidate other copies first)
+    bool needsBus(bool isWrite, uint32_t address);
+    
+    // Drops our copy of a block the shared L2 is evicting, writing it back first
+    // if dirty (dirty is set then); false if we hold no copy
+    bool invalidateForInclusion(uint32_t address, uint64_t cycle, int coreId, class Bus& bus, bool& dirty);
+    
+    // Issues the oldest useful prefetch candidate if the bus is free; true if the bus was taken
+    bool issuePrefetch(uint64_t cycle, int coreId, class Bus& bus, std::vector<class Core*>& cores);
+    
+    // Set-based cache operations
+    int findWay(int setIndex, uint32_t tag);    // Occupied way holding tag, or -1
     CacheLine* findLine(int setIndex, uint32_t tag);
     std::pair<CacheKey, CacheLine*> findReplacement(int setIndex, uint64_t cycle);
     void updateLRU(int setIndex, uint32_t tag, uint64_t cycle);
+    void touch(CacheLine& line, uint64_t cycle);
     void insertLine(int setIndex, uint32_t tag, uint64_t cycle, bool isWrite, CacheState initialState);
     
-    // Bus and miss handling operations
+    // Counts a demand access that found its line; one whose fill is still in
+    // flight for MSHR merged (>= 0) is counted as a merged miss instead
+    void countHit(bool isWrite, uint32_t address, int merged);
+    
+    // Miss classification hooks
+    void recordHit(uint32_t address);
+    MissType recordMiss(uint32_t address);
+    void countMiss(MissType type);
+    void invalidatedBy(uint32_t address);   // Another core's write took our copy
+    void backInvalidatedBy(uint32_t address);   // The shared L2 evicted the block
+    
+    // Reports the other holders of a block to the bus sharing tracker, if any
+    void noteSharing(class Bus& bus, int coreId, uint32_t address, bool isWrite,
+                     std::vector<class Core*>& cores);
+    
+    // Appends to the bus event log when one is attached
+    void logEvent(class Bus& bus, uint64_t cycle, int coreId, EventType type, uint32_t address,
+                  CacheState prior, CacheState next, int supplier);
+    
+    // Bus and miss handling operations, templated on the protocol policy
     void busupdate(class Bus& bus);
+    template <class Policy>
+    void access(bool isWrite, uint32_t address, uint64_t cycle, int coreId,
+                Bus& bus, std::vector<Core*>& cores);
+    template <class Policy>
+    uint64_t evict(CacheLine& victim, uint32_t setIndex, uint64_t cycle, int coreId, Bus& bus,
+               std::vector<Core*>& cores);
+    template <class Policy>
+    uint64_t busRead(int coreId, uint32_t address, uint64_t cycle, Bus& bus,
+                     std::vector<Core*>& cores, CacheState& fillState);
+    template <class Policy>
+    uint64_t busReadExclusive(int coreId, uint32_t address, uint64_t cycle, Bus& bus,
+                              std::vector<Core*>& cores);
+    template <class Policy>
+    void nonBlockingMiss(bool isWrite, uint32_t address, uint64_t cycle, int coreId, Bus& bus,
+                         std::vector<Core*>& cores);
+    template <class Policy>
+    void fillMshr(int slot, uint64_t cycle, int coreId, Bus& bus, std::vector<Core*>& cores);
+    int findQueuedMshr(uint32_t address);
+    int findIssuedMshr(uint32_t address, uint64_t readyCycle);  // In-flight fill of the block, or -1
+    void recordMerge(bool isWrite, int slot);
+    void retireMshrs(uint64_t cycle);
+    template <class Policy>
+    bool backInvalidate(CacheLine& line, uint32_t address, uint64_t cycle, int coreId, Bus& bus);
+    template <class Policy>
+    bool prefetch(uint32_t address, uint64_t cycle, int coreId, Bus& bus, std::vector<Core*>& cores);
+    void releaseShared(CacheLine& victim, uint32_t victimAddress, int coreId, Bus& bus,
+                       std::vector<Core*>& cores);
+    template <class Policy>
     void handleReadMiss(int coreId, uint64_t address, uint64_t cycle, Bus& bus, 
                         std::vector<Core*>& cores, uint64_t haltcycles);
+    template <class Policy>
     void handleWriteMiss(int coreId, uint64_t address, uint64_t cycle, Bus& bus, 
                          std::vector<Core*>& cores, uint64_t haltcycles);
 };
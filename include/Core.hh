@@ -6,14 +6,21 @@
 #include <cstdint>
 #include <sstream>
 #include "Cache.hh"
+#include "ReuseDistance.hh"
 
 // A Request represents a memory access operation.
 struct Request {
     bool isWrite;       // true for write; false for read
     uint32_t address;   // 32-bit memory address
+    Request();
     Request(bool isWrite, uint32_t address);
 };
 
+class TraceStream;
+
+// Parses one trace line ("R 0x1234"); returns false for blank, comment or bad lines
+bool parseTraceLine(const std::string& line, const std::string& filename, Request& out);
+
 // Core represents a processor core with its own cache and execution trace.
 class Core {
 public:
@@ -26,9 +33,22 @@ public:
     uint64_t readCount;         // Total read operations
     uint64_t writeCount;        // Total write operations
     uint64_t execycles;
+    bool parked;                // Waiting in the bus arbitration queue
+    uint64_t parkedSince;       // Cycle at which the core was parked
+    ReuseDistance* reuse;       // Optional reuse-distance analysis, fed while loading
+    TraceStream* stream;        // Pipelined trace source; null when using trace
+    Request current;            // Request at instPtr when streaming
+    size_t fetched;             // Requests taken from the stream so far
     Core(int id, Cache* cache);
+    ~Core();
     // Loads a trace file into the core's trace vector.
     void loadTrace(const std::string& filename);
+    // Appends one request behind those not yet performed, counting it like a loaded one.
+    void pushRequest(const Request& req);
+    // Starts decoding a trace file on a background thread instead of loading it.
+    void streamTrace(const std::string& filename);
+    // Request at instPtr, or nullptr once the trace is exhausted.
+    const Request* currentRequest();
 };
 
 #endif // CORE_H
\ No newline at end of file
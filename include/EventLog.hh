@@ -0,0 +1,86 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Coherence event kinds stored in EventRecord::type
+enum EventType {
+    EV_BUS_RD,          // Read miss on the bus
+    EV_BUS_RDX,         // Write miss on the bus (read for ownership)
+    EV_BUS_UPGRADE,     // Write hit on a shared line invalidating other copies
+    EV_WRITEBACK,       // Dirty block written back to memory
+    EV_EVICTION,        // Valid block replaced
+    EV_PREFETCH,        // Prefetch fill issued on an idle bus
+    EV_BACK_INVALIDATE, // L1 copy removed because the inclusive L2 evicted the block
+    EV_TYPE_COUNT
+};
+
+// One fixed-size log record; the layout is the on-disk format
+struct EventRecord {
+    uint64_t cycle;         // Cycle the transaction started
+    uint32_t block;         // address >> b
+    uint8_t core;           // Core whose line changed state
+    uint8_t type;           // EventType
+    uint8_t priorState;     // CacheState before the event
+    uint8_t newState;       // CacheState after the event
+    int8_t supplier;        // Core that supplied the data, -1 for memory
+    uint8_t reserved[7];
+};
+static_assert(sizeof(EventRecord) == 24, "EventRecord layout is part of the log format");
+
+// File header written once at the start of the log
+struct EventLogHeader {
+    char magic[8];          // "HCEVLOG1"
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t blockBits;
+    uint32_t reserved;
+};
+static_assert(sizeof(EventLogHeader) == 24, "EventLogHeader layout is part of the log format");
+
+// Append-only binary log of coherence events. Records are staged in memory
+// and written out in large blocks, so logging costs a store per event.
+class EventLog {
+public:
+    static const uint32_t VERSION = 1;
+    static const size_t BUFFER_RECORDS = 1 << 16;
+    
+    uint64_t recorded;      // Records written so far
+    
+    EventLog();
+    ~EventLog();            // Closes, if close() was not called
+    
+    bool open(const std::string& filename, int b);
+    
+    // Flushes and closes the file; false, after reporting it, if any write failed
+    bool close();
+    
+    void record(uint64_t cycle, int core, EventType type, uint32_t block,
+                int priorState, int newState, int supplier) {
+        EventRecord& r = buffer[used++];
+        r.cycle = cycle;
+        r.block = block;
+        r.core = static_cast<uint8_t>(core);
+        r.type = static_cast<uint8_t>(type);
+        r.priorState = static_cast<uint8_t>(priorState);
+        r.newState = static_cast<uint8_t>(newState);
+        r.supplier = static_cast<int8_t>(supplier);
+        if (used == BUFFER_RECORDS)
+            flush();
+    }
+    
+    void flush();
+
+private:
+    FILE* file;
+    std::string filename;
+    bool failed;            // A write came up short; the log on disk is incomplete
+    std::vector<EventRecord> buffer;
+    size_t used;
+};
+
+#endif // EVENT_LOG_H
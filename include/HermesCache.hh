@@ -0,0 +1,148 @@
+#ifndef HERMESCACHE_H
+#define HERMESCACHE_H
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Public interface of libhermescache: feeds accesses to the simulator straight
+// from memory, with no trace files. Only this header is installed; the simulator
+// itself stays behind HermesCache.
+//
+// The interface is source compatible only. Fields are appended to the structs
+// below as the simulator grows, which changes their size, so a program must be
+// rebuilt against the header of the library it runs with.
+
+// Bumped whenever a struct in this header changes
+const int HERMESCACHE_VERSION = 2;
+
+// HERMESCACHE_VERSION as the library was built; a program linked against a
+// shared library should refuse to run if the two differ
+int hermesCacheVersion();
+
+enum HermesProtocol {
+    HERMES_MESI,
+    HERMES_MOESI,
+    HERMES_MESIF
+};
+
+enum HermesPrefetcher {
+    HERMES_PREFETCH_NONE,
+    HERMES_PREFETCH_NEXT_LINE,
+    HERMES_PREFETCH_STRIDE
+};
+
+enum HermesL2Replacement {
+    HERMES_L2_LRU,
+    HERMES_L2_RANDOM
+};
+
+enum HermesArbitration {
+    HERMES_ARBITRATION_RETRY,
+    HERMES_ARBITRATION_FIFO
+};
+
+// Same meaning and defaults as the L1simulate options
+struct HermesConfig {
+    int s;                      // Set index bits (-s)
+    int E;                      // Associativity (-E)
+    int b;                      // Block bits (-b)
+    HermesProtocol protocol;    // (-p)
+    HermesPrefetcher prefetcher;    // (-P)
+    int prefetchDegree;         // (-D)
+    int prefetchDistance;       // (-d)
+    int mshrs;                  // MSHRs per core, 0 for blocking caches (-M)
+    int l2s;                    // Shared L2 geometry (-L), no L2 while l2s < 0;
+    int l2E;                    //   l2b must be at least b
+    int l2b;
+    int l2HitLatency;           // (-H)
+    HermesL2Replacement l2Replacement;  // (-R)
+    HermesArbitration arbitration;      // (-A)
+
+    HermesConfig();
+};
+
+struct HermesAccess {
+    uint8_t core;               // 0 to HermesCache::NUM_CORES - 1
+    bool isWrite;
+    uint32_t address;
+};
+
+struct HermesCoreStats {
+    uint64_t reads;             // Accesses pushed so far, performed or not
+    uint64_t writes;
+    uint64_t executionCycles;
+    uint64_t idleCycles;
+    uint64_t readHits;
+    uint64_t readMisses;
+    uint64_t writeHits;
+    uint64_t writeMisses;
+    uint64_t compulsoryMisses;
+    uint64_t capacityMisses;
+    uint64_t conflictMisses;
+    uint64_t coherenceMisses;
+    uint64_t inclusionMisses;   // Lost to L2 back-invalidation; zero without an L2
+    uint64_t evictions;
+    uint64_t writebacks;
+    uint64_t invalidations;
+    uint64_t trafficBytes;
+    uint64_t prefetchesIssued;  // Prefetch fields stay zero without a prefetcher
+    uint64_t usefulPrefetches;
+    uint64_t latePrefetches;
+    uint64_t uselessPrefetches;
+    uint64_t mshrMerges;        // MSHR fields stay zero for blocking caches
+    uint64_t mshrFullStallCycles;
+    uint64_t backInvalidations; // Lines lost to L2 victims; zero without an L2
+    uint64_t prefetchDelayCycles;   // Demand wait behind prefetch bus tenures
+};
+
+struct HermesBusStats {
+    uint64_t transactions;
+    uint64_t trafficBytes;
+    uint64_t cycle;             // Current simulated cycle
+};
+
+struct HermesL2Stats {
+    bool enabled;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writebacks;
+    uint64_t backInvalidations;
+    uint64_t snoopsFiltered;
+    uint64_t inclusionViolations;
+};
+
+class HermesCache {
+public:
+    static const int NUM_CORES = 4;
+
+    // Throws std::invalid_argument if the L2 blocks are smaller than the L1 blocks,
+    // or a prefetcher is enabled with a degree or distance below 1
+    explicit HermesCache(const HermesConfig& config = HermesConfig());
+    ~HermesCache();
+    HermesCache(const HermesCache&) = delete;
+    HermesCache& operator=(const HermesCache&) = delete;
+
+    // Queues accesses behind those already pushed for their cores. Nothing is
+    // queued, and false is returned, if any access names a core out of range.
+    bool push(const HermesAccess* accesses, size_t count);
+    bool push(const std::vector<HermesAccess>& accesses);
+
+    // Simulates at least the given number of cycles, stopping early once every
+    // queued access has completed; false in that case
+    bool step(uint64_t cycles = 1);
+
+    // Simulates until every queued access has completed
+    void drain();
+
+    HermesCoreStats coreStats(int core) const;
+    HermesBusStats busStats() const;
+    HermesL2Stats l2Stats() const;
+
+private:
+    struct Impl;
+    Impl* impl;
+};
+
+#endif // HERMESCACHE_H
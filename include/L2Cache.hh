@@ -0,0 +1,80 @@
+#ifndef L2CACHE_H
+#define L2CACHE_H
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum L2Replacement {
+    L2_LRU,
+    L2_RANDOM
+};
+
+// A valid L2 line displaced by an allocation; its L1 copies must go too
+struct L2Victim {
+    bool valid;
+    bool dirty;
+    uint32_t address;
+
+    L2Victim() : valid(false), dirty(false), address(0) {}
+};
+
+// Shared, inclusive L2 between the bus and memory. It only holds tags: the Bus
+// looks blocks up here on L1 fills and writebacks, and back-invalidates the L1
+// copies of every victim so that any block in an L1 is also in the L2.
+class L2Cache {
+public:
+    int s, E, b;
+    uint64_t hitLatency;
+    L2Replacement replacement;
+
+    // Statistics
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writebacks;            // Dirty victims written to memory
+    uint64_t backInvalidations;     // L1 lines invalidated to keep inclusion
+    uint64_t snoopsFiltered;        // Bus reads answered without probing the L1s
+    uint64_t inclusionViolations;   // L1 writebacks of blocks the L2 did not hold; always 0 unless inclusion is broken
+
+    L2Cache(int s, int E, int b, uint64_t hitLatency, L2Replacement replacement);
+
+    bool contains(uint32_t address) const;
+
+    // Looks a block up, allocating it on a miss; true on a hit. dirty marks the
+    // line as holding an L1 writeback. A valid line displaced by the
+    // allocation is returned in victim.
+    bool access(uint32_t address, bool dirty, L2Victim& victim);
+    
+    // Marks a block dirty with an L1 writeback; false (and counted as an
+    // inclusion violation) if the block is absent. Never allocates.
+    bool writeBack(uint32_t address);
+    
+    // Whether access() would displace a valid block to allocate this one, and
+    // which; changes nothing, including the random replacement state
+    bool wouldDisplace(uint32_t address, uint32_t& victimAddress) const;
+
+private:
+    struct Line {
+        bool valid;
+        bool dirty;
+        uint32_t tag;
+        uint64_t lruStamp;
+
+        Line() : valid(false), dirty(false), tag(0), lruStamp(0) {}
+    };
+
+    std::vector<Line> lines;    // Set-major: way w of set i lives at lines[i * E + w]
+    uint64_t lruClock;
+    uint32_t rng;               // xorshift state for L2_RANDOM (fixed seed, reproducible)
+
+    int findWay(uint32_t setIndex, uint32_t tag) const;
+    // Way to displace from a full set; advances state for L2_RANDOM
+    int chooseVictim(const Line* set, uint32_t& state) const;
+};
+
+// Parses "lru" or "random"; false if unrecognised
+bool parseL2Replacement(const std::string& name, L2Replacement& replacement);
+const char* l2ReplacementName(L2Replacement replacement);
+
+#endif // L2CACHE_H
@@ -0,0 +1,72 @@
+#ifndef MISS_CLASSIFIER_H
+#define MISS_CLASSIFIER_H
+
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+// Kinds of miss reported by the classifier
+enum MissType {
+    COMPULSORY_MISS,    // First reference to the block by this cache
+    CAPACITY_MISS,      // Would also miss in a fully-associative LRU cache of equal size
+    CONFLICT_MISS,      // Hits in the fully-associative shadow, misses in the real sets
+    COHERENCE_MISS,     // Block was last lost to another core's invalidation
+    INCLUSION_MISS      // Block was last lost to a back-invalidation by the shared L2
+};
+
+// Splits one cache's misses into the 3C categories plus coherence.
+// The shadow fully-associative cache is an index-linked LRU list sized to the
+// real cache, and first touches are kept in a bitmap paged in on demand, so
+// memory grows with the cache size and the touched address range only.
+class MissClassifier {
+public:
+    MissClassifier(size_t lines, int b);
+    
+    // Keeps the shadow cache in step with a hit in the real cache
+    void hit(uint32_t address);
+    
+    // Classifies a miss in the real cache and updates the shadow cache
+    MissType miss(uint32_t address);
+    
+    // Records that another core's write invalidated our copy of the block, and
+    // drops it from the shadow cache, which no longer holds it either
+    void invalidated(uint32_t address);
+    
+    // Same for a copy removed to keep the shared L2 inclusive
+    void backInvalidated(uint32_t address);
+
+private:
+    static const uint32_t NIL = UINT32_MAX;
+    static const int PAGE_BITS = 15;    // Blocks per first-touch bitmap page
+    
+    struct ShadowNode {
+        uint32_t block;
+        uint32_t prev;
+        uint32_t next;
+    };
+    
+    int b;
+    size_t capacity;
+    
+    // Shadow fully-associative LRU: nodes are recycled in place once full
+    std::vector<ShadowNode> nodes;
+    std::vector<uint32_t> freeNodes;    // Nodes of invalidated blocks, reused first
+    std::unordered_map<uint32_t, uint32_t> shadowIndex;    // Block -> node
+    uint32_t head;      // Most recently used
+    uint32_t tail;      // Least recently used
+    
+    std::unordered_map<uint32_t, std::vector<uint64_t> > touchedPages;
+    std::unordered_set<uint32_t> coherenceLost;
+    std::unordered_set<uint32_t> inclusionLost;
+    
+    bool firstTouch(uint32_t block);    // Marks the block; true if it was unseen
+    bool shadowAccess(uint32_t block);  // Moves/inserts at MRU; true on a shadow hit
+    void unlink(uint32_t node);
+    void dropShadow(uint32_t block);    // Removes the block from the shadow cache, if present
+    void pushFront(uint32_t node);
+};
+
+#endif // MISS_CLASSIFIER_H
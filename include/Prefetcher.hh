@@ -0,0 +1,53 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+
+enum PrefetcherKind {
+    PREFETCH_NONE,
+    PREFETCH_NEXT_LINE,     // Blocks following a miss or a first hit on a prefetched block
+    PREFETCH_STRIDE         // Blocks along a repeated block stride (no PC available)
+};
+
+// Per-core L1 prefetcher. It only proposes block addresses; the simulator issues
+// them through the Bus when it is idle, so prefetches compete with demand misses.
+class Prefetcher {
+public:
+    static const size_t MAX_QUEUE = 16;     // Oldest candidates are dropped beyond this
+    
+    PrefetcherKind kind;
+    int degree;         // Blocks proposed per trigger
+    int distance;       // How many blocks ahead the first proposal is
+    
+    std::deque<uint32_t> queue;     // Candidate addresses awaiting the bus
+    
+    // Statistics
+    uint64_t issued;        // Prefetches that went on the bus
+    uint64_t useful;        // Prefetched blocks later hit by a demand access
+    uint64_t late;          // Useful prefetches hit before their data arrived
+    uint64_t useless;       // Prefetched blocks evicted or invalidated unused
+    uint64_t dropped;       // Candidates skipped to avoid forcing a writeback or a back-invalidation
+    uint64_t trafficBytes;  // Bus traffic caused by prefetches
+    
+    Prefetcher(PrefetcherKind kind, int b, int degree, int distance);
+    
+    // Observes a demand access. firstUse is true on the first hit to a prefetched block.
+    void observe(uint32_t address, bool miss, bool firstUse);
+
+private:
+    int b;
+    uint32_t lastBlock;
+    int64_t lastStride;
+    bool haveLast;
+    
+    void propose(int64_t block);
+};
+
+// Parses "none", "nextline" or "stride"; false if unrecognised
+bool parsePrefetcher(const std::string& name, PrefetcherKind& kind);
+const char* prefetcherName(PrefetcherKind kind);
+
+#endif // PREFETCHER_H
@@ -0,0 +1,67 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#pragma once
+#include <string>
+#include "Cache.hh"
+
+// Coherence protocol state machines as compile-time policies. Cache's access
+// and miss handlers are templated on one of these; the only runtime switch is
+// the dispatch in Cache::accessCache on Cache::protocol.
+//
+// Each policy answers the same questions:
+//   remoteRead(s)      state a remote copy moves to when another core reads the block
+//   supplyRank(s)      preference for supplying a read cache-to-cache (0 = best, -1 = never)
+//   writebackOnSupply  whether supplying from s first writes the block back to memory
+//   readFill(shared)   state of the requester's copy after a read miss
+//   dirty(s)           s holds data newer than memory
+//   needsUpgrade(s)    a write hit in s must invalidate other copies first
+
+struct MesiPolicy {
+    static const ProtocolKind kind = PROTOCOL_MESI;
+    static CacheState remoteRead(CacheState) { return SHARED; }
+    static int supplyRank(CacheState s) {
+        return s == MODIFIED ? 0 : s == EXCLUSIVE ? 1 : s == SHARED ? 2 : -1;
+    }
+    static bool writebackOnSupply(CacheState s) { return s == MODIFIED; }
+    static CacheState readFill(bool shared) { return shared ? SHARED : EXCLUSIVE; }
+    static bool dirty(CacheState s) { return s == MODIFIED; }
+    static bool needsUpgrade(CacheState s) { return s == SHARED; }
+};
+
+// MOESI: a MODIFIED copy that is read becomes OWNED and keeps supplying the
+// dirty block, so no writeback is needed until the owner evicts it
+struct MoesiPolicy {
+    static const ProtocolKind kind = PROTOCOL_MOESI;
+    static CacheState remoteRead(CacheState s) {
+        return (s == MODIFIED || s == OWNED) ? OWNED : SHARED;
+    }
+    static int supplyRank(CacheState s) {
+        return (s == MODIFIED || s == OWNED) ? 0 : s == EXCLUSIVE ? 1 : s == SHARED ? 2 : -1;
+    }
+    static bool writebackOnSupply(CacheState) { return false; }
+    static CacheState readFill(bool shared) { return shared ? SHARED : EXCLUSIVE; }
+    static bool dirty(CacheState s) { return s == MODIFIED || s == OWNED; }
+    static bool needsUpgrade(CacheState s) { return s == SHARED || s == OWNED; }
+};
+
+// MESIF: only the FORWARD copy (the most recent reader) answers a read, plain
+// SHARED copies stay silent, so a block with no forwarder comes from memory
+struct MesifPolicy {
+    static const ProtocolKind kind = PROTOCOL_MESIF;
+    static CacheState remoteRead(CacheState) { return SHARED; }
+    static int supplyRank(CacheState s) {
+        return s == MODIFIED ? 0 : (s == EXCLUSIVE || s == FORWARD) ? 1 : -1;
+    }
+    static bool writebackOnSupply(CacheState s) { return s == MODIFIED; }
+    static CacheState readFill(bool shared) { return shared ? FORWARD : EXCLUSIVE; }
+    static bool dirty(CacheState s) { return s == MODIFIED; }
+    static bool needsUpgrade(CacheState s) { return s == SHARED || s == FORWARD; }
+};
+
+const char* protocolName(ProtocolKind kind);
+
+// Parses "mesi", "moesi" or "mesif" (any case); false if unrecognised
+bool parseProtocol(const std::string& name, ProtocolKind& kind);
+
+#endif // PROTOCOL_H
@@ -0,0 +1,50 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+// On-disk store of printResults output, keyed by the content of the input traces,
+// the simulation options and the simulator version. Each result is one file in
+// the cache directory; least recently used files are deleted once the directory
+// exceeds its byte budget. Counters persist in a "stats" file next to them.
+class ResultCache {
+public:
+    // Persistent counters, updated on every lookup/store
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+    
+    ResultCache(const std::string& directory, uint64_t budgetBytes);
+    
+    // 64-bit content hash of a file; false if it cannot be read
+    static bool hashFile(const std::string& filename, uint64_t& hash);
+    
+    // Builds the lookup key; empty if any input file cannot be read
+    std::string makeKey(const std::vector<std::string>& inputs, const std::string& config) const;
+    
+    // Fills text with the stored result for key; false on a miss
+    bool lookup(const std::string& key, std::string& text);
+    
+    // Saves text under key, then evicts down to the budget
+    void store(const std::string& key, const std::string& text);
+    
+    // One-line summary of the counters and current directory usage
+    void printStats(std::ostream& out, bool hit);
+
+private:
+    std::string directory;
+    uint64_t budgetBytes;
+    bool usable;                // Directory exists or could be created
+    
+    std::string entryPath(const std::string& key) const;
+    void loadStats();
+    void saveStats() const;
+    void evict(uint64_t& entries, uint64_t& bytes);
+};
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,46 @@
+#ifndef REUSE_DISTANCE_H
+#define REUSE_DISTANCE_H
+
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <ostream>
+#include <string>
+
+// Online block-granularity reuse-distance analysis.
+// The distance of an access is the number of distinct blocks touched since the
+// previous access to the same block. Last-access times are marked in a Fenwick
+// tree so each access costs O(log n); the time axis is compacted whenever it
+// fills up, so memory stays proportional to the number of distinct blocks.
+class ReuseDistance {
+public:
+    int b;                              // Block bits (distances are per block)
+    
+    // histogram[0] counts distance 0, histogram[k] counts [2^(k-1), 2^k - 1]
+    std::vector<uint64_t> histogram;
+    uint64_t coldAccesses;              // First touches (infinite distance)
+    uint64_t totalAccesses;
+    
+    explicit ReuseDistance(int b);
+    
+    // Record one access and bucket its reuse distance
+    void access(uint32_t address);
+    
+    // Add another analyzer's histogram into this one
+    void merge(const ReuseDistance& other);
+    
+    // Prints the non-empty buckets, one per line
+    void print(std::ostream& out, const std::string& label) const;
+
+private:
+    std::vector<uint32_t> tree;                         // Fenwick tree over time slots
+    std::unordered_map<uint32_t, uint32_t> lastAccess;  // Block -> time slot of last access
+    uint32_t now;                                       // Next free time slot
+    
+    void add(uint32_t slot, int32_t delta);
+    uint32_t prefix(uint32_t slot) const;   // Marks in [0, slot]
+    void compact();
+};
+
+#endif // REUSE_DISTANCE_H
@@ -0,0 +1,71 @@
+#ifndef SHARING_TRACKER_H
+#define SHARING_TRACKER_H
+
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <ostream>
+
+// False-sharing detector. For every block it keeps, per core, bitmasks of the
+// offsets read and written since the block's last coherence transfer. Each
+// transfer or invalidation the requester causes is then classified against
+// what the other holders did with the block:
+//   - a read is true sharing if its offset was written by a holder, false
+//     sharing if holders wrote only other offsets, and neither if no holder
+//     wrote at all (clean read sharing);
+//   - a write is true sharing if its offset was read or written by a holder,
+//     and false sharing if holders used only other offsets, even if they only
+//     read them: their copies are invalidated for data they never needed.
+// Blocks wider than 64 bytes are tracked in 64 equal chunks. A block only one
+// core has touched needs just that core's masks; the per-core table is
+// allocated once a second core touches it.
+class SharingTracker {
+public:
+    static const int MAX_CORES = 4;
+    
+    uint64_t trueSharing;
+    uint64_t falseSharing;
+    
+    explicit SharingTracker(int b);
+    
+    // A core completed an access
+    void access(int coreId, uint32_t address, bool isWrite);
+    
+    // requesterId's access needs the copies held by the cores in holderMask:
+    // a transfer for reads, an invalidation for writes
+    void coherenceEvent(int requesterId, uint32_t address, bool isWrite, unsigned holderMask);
+    
+    // Prints totals and the blocks with the most false-sharing events
+    void print(std::ostream& out, size_t top = 10) const;
+    
+    // Blocks touched by more than one core, which carry per-core masks
+    size_t sharedBlocks() const { return blocks.size(); }
+
+private:
+    struct BlockSharing {
+        uint64_t readMask[MAX_CORES];
+        uint64_t writeMask[MAX_CORES];
+        uint64_t falseOffsets;      // Offsets involved in false-sharing events
+        uint32_t trueEvents;
+        uint32_t falseEvents;
+    };
+    
+    // A block only one core has touched so far
+    struct SoleOwner {
+        uint64_t readMask;
+        uint64_t writeMask;
+        int core;
+    };
+    
+    int b;
+    int chunkShift;                 // log2 of the bytes covered by one mask bit
+    std::unordered_map<uint32_t, SoleOwner> owned;
+    std::unordered_map<uint32_t, BlockSharing> blocks;
+    
+    // Moves a sole owner's masks into a per-core table, now that another core needs it
+    BlockSharing& share(std::unordered_map<uint32_t, SoleOwner>::iterator it);
+    uint64_t offsetBit(uint32_t address) const;
+    void printOffsets(std::ostream& out, uint64_t mask) const;
+};
+
+#endif // SHARING_TRACKER_H
@@ -3,26 +3,74 @@
 
 #include <string>
 #include <vector>
+#include <ostream>
 #include "Core.hh"
 #include "Bus.hh"
 
+// Bump whenever simulation results change, so cached results are invalidated
+const char* const SIMULATOR_VERSION = "hermescache-6";
+
 // Simulator coordinates all cores, caches, and bus transactions.
 class Simulator {
 private:
     int s, E, b;                // Cache configuration parameters
+    ProtocolKind protocol;      // Coherence protocol used by every cache
     std::vector<Core*> cores;   // Four processor cores
     Bus bus;                    // The bus for cache coherence transactions
     uint64_t globalCycle;       // Global simulation cycle
+    bool reuseAnalysis;         // Collect per-core reuse-distance histograms
+    EventLog* eventLog;         // Binary coherence event log, if enabled
+    SharingTracker* sharing;    // False-sharing detector, if enabled
+    L2Cache* l2;                // Shared inclusive L2, if enabled
+    bool prefetching;           // Caches carry a prefetcher
+    
+    // Performs the core's current request and feeds the sharing tracker once it retires
+    void issue(Core* core, uint64_t cycle);
+    // Gives the bus to a waiter popped from the arbitration queue
+    void grant(const Bus::Waiter& waiter);
+    // A parked core whose line changed while it waited, so that its access no
+    // longer needs the bus (e.g. a SHARED copy promoted to EXCLUSIVE)
+    bool stoppedWaiting(Core* core);
 
 public:
-    Simulator(int s, int E, int b);
+    Simulator(int s, int E, int b, ProtocolKind protocol = PROTOCOL_MESI);
     ~Simulator();
+    // Enables the reuse-distance pass; must be called before loading traces.
+    void enableReuseAnalysis();
+    // Records every coherence transaction to a binary log; false if it cannot be opened.
+    bool enableEventLog(const std::string& filename);
+    // Finishes the event log, if any; false if it could not be written in full.
+    bool closeEventLog();
+    // Tracks per-block byte offsets to separate true from false sharing.
+    void enableSharingAnalysis();
+    // Chooses how waiting cores are ordered for the bus (retry order by default).
+    void setArbitration(Arbitration arbitration);
+    // Gives every L1 a prefetcher; candidates are issued only while the bus is idle.
+    void enablePrefetcher(PrefetcherKind kind, int degree, int distance);
+    // Makes every L1 non-blocking with this many MSHRs; 0 keeps them blocking.
+    void enableNonBlocking(int mshrCount);
+    // Puts a shared inclusive L2 between the bus and memory; false if its blocks
+    // would be smaller than the L1 blocks.
+    bool enableL2(int s, int E, int b, uint64_t hitLatency, L2Replacement replacement);
     // Loads the trace files (expects baseName_proc0.trace ... baseName_proc3.trace).
     void loadTraces(const std::string& baseName);
+    // Like loadTraces, but decodes each file on its own thread while run() consumes it.
+    void streamTraces(const std::string& baseName);
+    // Queues one access for a core behind those it has not yet performed (no trace files needed).
+    void pushAccess(int coreId, bool isWrite, uint32_t address);
+    // Simulates the next cycle in which anything can happen; false once every queued
+    // access has completed. More accesses may be pushed afterwards and stepping resumed.
+    bool step();
     // Runs the simulation until all cores have completed their traces.
     void run();
+    
+    uint64_t currentCycle() const { return globalCycle; }
+    const std::vector<Core*>& getCores() const { return cores; }
+    const Bus& getBus() const { return bus; }
+    const L2Cache* getL2() const { return l2; }
     // Prints simulation results; if outFilename is nonempty, writes to that file.
     void printResults(const std::string& outFilename = "", const std::string& trace_prefix = "");
+    void printResults(std::ostream& os, const std::string& trace_prefix);
 };
 
 #endif // SIMULATOR_H
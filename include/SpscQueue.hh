@@ -0,0 +1,73 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#pragma once
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+// Bounded lock-free ring buffer for exactly one producer and one consumer thread.
+// Each side owns one index and keeps a cached copy of the other, so the shared
+// cache lines are only touched when the cached view says the ring looks full/empty.
+template <typename T>
+class SpscQueue {
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity)
+        : head(0), cachedTail(0), tail(0), cachedHead(0) {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+    
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    
+    // Producer side; returns false if the ring is full
+    bool push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask)
+                return false;
+        }
+        slots[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // Consumer side; returns false if the ring is empty
+    bool pop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail)
+                return false;
+        }
+        item = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static const size_t CACHE_LINE = 64;
+    
+    std::vector<T> slots;
+    size_t mask;
+    
+    // Consumer-owned; padding keeps the two sides on separate cache lines
+    // (explicit padding rather than alignas, which C++11 new cannot honour)
+    char padHead[CACHE_LINE];
+    std::atomic<size_t> head;
+    size_t cachedTail;
+    
+    // Producer-owned
+    char padTail[CACHE_LINE];
+    std::atomic<size_t> tail;
+    size_t cachedHead;
+    char padEnd[CACHE_LINE];
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,33 @@
+#ifndef TAG_MATCH_H
+#define TAG_MATCH_H
+
+#pragma once
+#include <cstdint>
+
+// Ways are compared in groups of this many tags; each set's tag row is padded
+// to a multiple of it and aligned to TAG_ALIGN bytes so vector loads never split.
+const int TAG_GROUP = 8;
+const int TAG_ALIGN = 32;
+
+// Tag stored in empty and padding ways. Real tags are address >> (s + b), so
+// they never reach this value unless s + b == 0.
+const uint32_t EMPTY_TAG = UINT32_MAX;
+
+// Returns the first way in tags[0, ways) holding tag, or -1.
+// tags must be TAG_ALIGN-aligned and ways a multiple of TAG_GROUP.
+typedef int (*TagMatchFn)(const uint32_t* tags, int ways, uint32_t tag);
+
+enum TagMatchKernel {
+    TAG_MATCH_SCALAR,
+    TAG_MATCH_SSE2,
+    TAG_MATCH_AVX2
+};
+
+// A specific kernel, or nullptr if it is not built in or the CPU lacks it
+TagMatchFn tagMatchKernel(TagMatchKernel kernel);
+
+// Picks the widest kernel the running CPU supports (AVX2, SSE2, scalar).
+// Sets with fewer than four ways always use the scalar loop.
+TagMatchFn selectTagMatch(int associativity);
+
+#endif // TAG_MATCH_H
@@ -0,0 +1,37 @@
+#ifndef TRACE_STREAM_H
+#define TRACE_STREAM_H
+
+#pragma once
+#include <string>
+#include <thread>
+#include <atomic>
+#include "Core.hh"
+#include "SpscQueue.hh"
+
+// Decodes one trace file on its own thread into a bounded SPSC ring, so that
+// file I/O and parsing overlap with simulation. The decoder blocks while the
+// ring is full, which keeps memory use fixed regardless of trace length, and
+// stops at the next line once the stream is destroyed.
+class TraceStream {
+public:
+    static const size_t DEFAULT_DEPTH = 1 << 16;    // Requests buffered per stream
+    
+    // Starts decoding immediately; reuse (if any) is fed on the decoder thread
+    TraceStream(const std::string& filename, ReuseDistance* reuse, size_t depth = DEFAULT_DEPTH);
+    ~TraceStream();
+    
+    // Consumer side: waits for the next request; false once the trace is exhausted
+    bool next(Request& out);
+
+private:
+    std::string filename;
+    ReuseDistance* reuse;
+    SpscQueue<Request> queue;
+    std::atomic<bool> finished;     // Set by the decoder after its last push
+    std::atomic<bool> stopping;     // Set by the consumer to abandon decoding
+    std::thread decoder;
+    
+    void decode();
+};
+
+#endif // TRACE_STREAM_H
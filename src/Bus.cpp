@@ -2,7 +2,8 @@
 #include "Core.hh"
 
 Bus::Bus() : busTransactions(0), invalidations(0), trafficBytes(0),  
-                isbusy(false), freeCycle(0), moreleft(false), coreid(0) {}
+                isbusy(false), freeCycle(0), moreleft(false), coreid(0), prefetchTenure(false), eventLog(nullptr), sharing(nullptr), l2(nullptr),
+                arbitration(ARBITRATION_RETRY) {}
 
 Bus::BusResult Bus::busRd(int requesterId, uint32_t address, std::vector<Core*>& cores, int s, int b) {
     busTransactions++;  // Increment transactions counter for statistics
@@ -10,11 +11,17 @@ Bus::BusResult Bus::busRd(int requesterId, uint32_t address, std::vector<Core*>&
     uint32_t tag = address >> (s + b);
     BusResult result = NO_DATA;
     
+    // An inclusive L2 doubles as a snoop filter: a block it lacks is in no L1
+    if (l2 && !l2->contains(address)) {
+        l2->snoopsFiltered++;
+        return result;
+    }
+    
     // Check all other cores for the requested line
     for (Core* core : cores) {
         if (core->id == requesterId) continue;  // Skip requesting core
         
-        // Use the hashmap-based lookup for efficiency
+        // Use the SIMD set lookup for efficiency
         CacheLine* line = core->cache->findLine(setIndex, tag);
         if (line != nullptr && line->state != INVALID) {
             // Found the line in another cache
@@ -24,6 +31,12 @@ Bus::BusResult Bus::busRd(int requesterId, uint32_t address, std::vector<Core*>&
             } else if(line->state == SHARED) {
                 // Shared data can be supplied directly
                 result = SHARED_DATA;
+            } else if (line->state == OWNED) {
+                // Dirty shared data, supplied by its owner (MOESI)
+                result = OWNED_DATA;
+            } else if (line->state == FORWARD) {
+                // Clean shared data, supplied by the forwarder (MESIF)
+                result = FORWARD_DATA;
             }
             else {
                 // Exclusive data needs to be changed to shared
@@ -42,16 +55,21 @@ Bus::BusResult Bus::busRdX(int requesterId, uint32_t address, std::vector<Core*>
     uint32_t tag = address >> (s + b);
     BusResult result = NO_DATA;
     
+    if (l2 && !l2->contains(address)) {
+        l2->snoopsFiltered++;
+        return result;
+    }
+    
     // Check other cores for copies of this line
     for (Core* core : cores) {
         if (core->id == requesterId) continue;  // Skip requesting core
         
-        // Use the hashmap-based lookup
+        // Use the SIMD set lookup
         CacheLine* line = core->cache->findLine(setIndex, tag);
         if (line != nullptr && line->valid && line->state != INVALID) {
             // Found a copy in another cache
-            if (line->state == MODIFIED) {
-                // Modified data requires writeback before invalidation
+            if (line->state == MODIFIED || line->state == OWNED) {
+                // Dirty data requires writeback before invalidation
                 result = MODIFIED_DATA;
             } else {
                 // Shared or Exclusive can be invalidated directly
@@ -59,7 +77,8 @@ Bus::BusResult Bus::busRdX(int requesterId, uint32_t address, std::vector<Core*>
             }
             
             // Invalidate the line in the other cache
-            line->state = INVALID;
+            core->cache->setState(*line, INVALID);
+            core->cache->invalidatedBy(address);
         }
     }
     
@@ -79,7 +98,139 @@ void Bus::busUpgrade(int requesterId, uint32_t address, std::vector<Core*>& core
         // Find and invalidate any copies in other caches
         CacheLine* line = core->cache->findLine(setIndex, tag);
         if (line != nullptr && line->state != INVALID) {
-            line->state = INVALID;  // Invalidate the line
+            core->cache->setState(*line, INVALID);  // Invalidate the line
+            core->cache->invalidatedBy(address);
+        }
+    }
+}
+uint64_t Bus::fetchBlock(uint32_t address, uint64_t cycle, std::vector<Core*>& cores) {
+    if (!l2)
+        return MEMORY_LATENCY;
+    
+    L2Victim victim;
+    bool hit = l2->access(address, false, victim);
+    uint64_t latency = hit ? l2->hitLatency : l2->hitLatency + MEMORY_LATENCY;
+    if (victim.valid)
+        latency += backInvalidate(victim, cycle, cores);
+    return latency;
+}
+
+uint64_t Bus::writeBackBlock(uint32_t address) {
+    if (!l2)
+        return MEMORY_LATENCY;
+    
+    // Inclusion guarantees the block is present and the L2 absorbs the write.
+    // A miss is an inclusion bug: it is counted, and the data goes to memory
+    // rather than allocating (and possibly back-invalidating) behind our back.
+    if (l2->writeBack(address))
+        return l2->hitLatency;
+    return MEMORY_LATENCY;
+}
+
+bool Bus::fetchWouldBackInvalidate(uint32_t address, std::vector<Core*>& cores) const {
+    uint32_t victimAddress;
+    if (!l2 || !l2->wouldDisplace(address, victimAddress))
+        return false;
+    for (Core* core : cores) {
+        Cache* cache = core->cache;
+        uint32_t blocks = 1u << (l2->b - cache->b);
+        for (uint32_t i = 0; i < blocks; i++) {
+            uint32_t l1Address = victimAddress + (i << cache->b);
+            uint32_t setIndex = (l1Address >> cache->b) & ((1 << cache->s) - 1);
+            if (cache->findLine(setIndex, l1Address >> (cache->s + cache->b)) != nullptr)
+                return true;
+        }
+    }
+    return false;
+}
+
+uint64_t Bus::backInvalidate(L2Victim& victim, uint64_t cycle, std::vector<Core*>& cores) {
+    // The L2 block may span several L1 blocks; every L1 copy of each one goes,
+    // and dirty copies are merged into the victim's writeback to memory
+    for (Core* core : cores) {
+        Cache* cache = core->cache;
+        uint32_t blocks = 1u << (l2->b - cache->b);
+        for (uint32_t i = 0; i < blocks; i++) {
+            uint32_t address = victim.address + (i << cache->b);
+            bool dirty = false;
+            if (cache->invalidateForInclusion(address, cycle, core->id, *this, dirty))
+                l2->backInvalidations++;
+            victim.dirty = victim.dirty || dirty;
+        }
+    }
+    if (!victim.dirty)
+        return 0;
+    l2->writebacks++;
+    return MEMORY_LATENCY;
+}
+
+void Bus::requestBus(int coreId, uint64_t cycle, std::vector<Core*>& cores) {
+    Core* core = cores[coreId];
+    if (core->parked) return;  // Already queued
+    core->parked = true;
+    core->parkedSince = cycle;
+    chargePrefetchDelay(core, cycle);
+    Waiter waiter = { coreId, -1 };
+    waitQueue.push_back(waiter);
+}
+
+void Bus::queueMiss(int coreId, int mshr, uint64_t cycle, std::vector<Core*>& cores) {
+    chargePrefetchDelay(cores[coreId], cycle);
+    Waiter waiter = { coreId, mshr };
+    waitQueue.push_back(waiter);
+}
+
+void Bus::chargePrefetchDelay(Core* core, uint64_t cycle) {
+    // A prefetch is never preempted, so the earliest grant is the cycle after it ends
+    if (isbusy && prefetchTenure && freeCycle + 1 > cycle)
+        core->cache->prefetchDelayCycles += freeCycle + 1 - cycle;
+}
+
+Bus::Waiter Bus::grantBus(uint64_t cycle, std::vector<Core*>& cores) {
+    if (waitQueue.empty()) {
+        Waiter none = { -1, -1 };
+        return none;
+    }
+    return grant(waitQueue.begin(), cycle, cores);
+}
+
+Bus::Waiter Bus::grantBus(uint64_t cycle, std::vector<Core*>& cores, int coreId) {
+    for (std::deque<Waiter>::iterator it = waitQueue.begin(); it != waitQueue.end(); ++it) {
+        if (it->coreId == coreId)
+            return grant(it, cycle, cores);
+    }
+    Waiter none = { -1, -1 };
+    return none;
+}
+
+void Bus::unpark(int coreId, uint64_t cycle, std::vector<Core*>& cores) {
+    for (std::deque<Waiter>::iterator it = waitQueue.begin(); it != waitQueue.end(); ++it) {
+        if (it->coreId == coreId && it->mshr < 0) {
+            grant(it, cycle, cores);
+            return;
         }
     }
-}
\ No newline at end of file
+}
+
+Bus::Waiter Bus::grant(std::deque<Waiter>::iterator it, uint64_t cycle, std::vector<Core*>& cores) {
+    Waiter waiter = *it;
+    waitQueue.erase(it);
+    if (waiter.mshr >= 0) return waiter;
+    
+    // Every cycle spent in the queue is an idle cycle for the waiting core
+    Core* core = cores[waiter.coreId];
+    core->cache->idleCycles += cycle - core->parkedSince;
+    core->parked = false;
+    return waiter;
+}
+
+bool parseArbitration(const std::string& name, Arbitration& arbitration) {
+    if (name == "retry") arbitration = ARBITRATION_RETRY;
+    else if (name == "fifo") arbitration = ARBITRATION_FIFO;
+    else return false;
+    return true;
+}
+
+const char* arbitrationName(Arbitration arbitration) {
+    return arbitration == ARBITRATION_FIFO ? "FIFO" : "Retry";
+}
@@ -1,172 +1,197 @@
 #include "Cache.hh"
 #include "Bus.hh"
 #include "Core.hh"
+#include "Protocol.hh"
 #include <algorithm>
 #include <climits>
 
-Cache::Cache(int s, int E, int b) 
+Cache::Cache(int s, int E, int b, ProtocolKind protocol) 
     : s(s), E(E), b(b), 
+      tagStride(0), tags(nullptr), tagMatch(selectTagMatch(E)), lruClock(0),
       readHits(0), readMisses(0), writeHits(0), writeMisses(0), 
-      writeBacks(0), idleCycles(0), evictions(0), trafficBytes(0), invalidations(0) {
+      writeBacks(0), idleCycles(0), evictions(0), trafficBytes(0), invalidations(0), backInvalidations(0), prefetchDelayCycles(0),
+      compulsoryMisses(0), capacityMisses(0), conflictMisses(0), coherenceMisses(0), inclusionMisses(0),
+      classifier(static_cast<size_t>(1 << s) * E, b), protocol(protocol), transitions(), prefetcher(nullptr),
+      mshrAllocations(0), mshrMerges(0), mshrFullStalls(0), mshrBusyCycles(0), mshrPeak(0), lastFillCycle(0) {
     
-    // Initialize the map-based cache structure
-    // Create one LRU list and one map for each set
-    int numSets = (1 << s);
-    lruLists.resize(numSets);
-    cacheMaps.resize(numSets);
+    // Allocate E lines per set, plus a padded tag row per set for the matcher
+    size_t numSets = static_cast<size_t>(1) << s;
+    lines.resize(numSets * E);
+    setFill.assign(numSets, 0);
+    
+    tagStride = (E + TAG_GROUP - 1) / TAG_GROUP * TAG_GROUP;
+    tagStorage.assign(numSets * tagStride + TAG_ALIGN / sizeof(uint32_t), EMPTY_TAG);
+    uintptr_t base = reinterpret_cast<uintptr_t>(tagStorage.data());
+    tags = reinterpret_cast<uint32_t*>((base + TAG_ALIGN - 1) & ~static_cast<uintptr_t>(TAG_ALIGN - 1));
+}
+
+Cache::~Cache() {
+    delete prefetcher;
+}
+
+int Cache::findWay(int setIndex, uint32_t tag) {
+    // Tags are unique within a set, so the first match is the only one
+    int way = tagMatch(tags + static_cast<size_t>(setIndex) * tagStride, tagStride, tag);
+    if (way < 0 || way >= E || !lines[static_cast<size_t>(setIndex) * E + way].valid)
+        return -1;
+    return way;
 }
 
 CacheLine* Cache::findLine(int setIndex, uint32_t tag) {
-    // Create a key for the cache lookup using the set index and tag
-    CacheKey key(setIndex, tag);
-    auto& cacheMap = cacheMaps[setIndex];
-    auto it = cacheMap.find(key);
-    
     // Return a pointer to the cache line if found and valid, otherwise return null
-    if (it != cacheMap.end() && it->second.first.valid && it->second.first.state != INVALID) {
-        return &(it->second.first);
-    }
-    return nullptr;
+    int way = findWay(setIndex, tag);
+    if (way < 0)
+        return nullptr;
+    CacheLine& line = lines[static_cast<size_t>(setIndex) * E + way];
+    return line.state != INVALID ? &line : nullptr;
+}
+
+void Cache::touch(CacheLine& line, uint64_t cycle) {
+    // Move the line to the most recently used position
+    line.lruStamp = ++lruClock;
+    line.lastUsedCycle = cycle;
 }
 
 void Cache::updateLRU(int setIndex, uint32_t tag, uint64_t cycle) {
-    // Create a key for the cache lookup
-    CacheKey key(setIndex, tag);
-    auto& lruList = lruLists[setIndex];
-    auto& cacheMap = cacheMaps[setIndex];
-    
-    auto it = cacheMap.find(key);
-    if (it != cacheMap.end()) {
-        // Move the item to the front of the LRU list (most recently used position)
-        lruList.erase(it->second.second);  // Remove from current position
-        lruList.push_front(key);           // Add to front of list
-        
-        // Update the cache map entry with the new list position and cycle
-        it->second.second = lruList.begin();
-        it->second.first.lastUsedCycle = cycle;
-    }
+    int way = findWay(setIndex, tag);
+    if (way >= 0)
+        touch(lines[static_cast<size_t>(setIndex) * E + way], cycle);
 }
 
 std::pair<CacheKey, CacheLine*> Cache::findReplacement(int setIndex, uint64_t cycle) {
-    auto& lruList = lruLists[setIndex];
-    auto& cacheMap = cacheMaps[setIndex];
-    
     // If the set isn't full, we don't need to replace anything yet
-    if (cacheMap.size() < static_cast<size_t>(E)) {
+    if (setFill[setIndex] < E) {
         // Return a placeholder key with null cache line (indicating space available)
         CacheKey newKey(setIndex, 0);
         return std::make_pair(newKey, nullptr);
     }
     
     // Otherwise, we need to evict the least recently used entry
-    if (!lruList.empty()) {
-        // Get the least recently used item (back of the LRU list)
-        CacheKey victimKey = lruList.back();
-        auto it = cacheMap.find(victimKey);
-        if (it != cacheMap.end()) {
-            // Return the key and a pointer to the cache line to be replaced
-            return std::make_pair(victimKey, &it->second.first);
-        }
+    CacheLine* set = &lines[static_cast<size_t>(setIndex) * E];
+    CacheLine* victim = set;
+    for (int w = 1; w < E; w++) {
+        if (set[w].lruStamp < victim->lruStamp)
+            victim = &set[w];
     }
-    
-    // Safety fallback - should never reach here with proper implementation
-    CacheKey fallbackKey(setIndex, 0);
-    return std::make_pair(fallbackKey, nullptr);
+    return std::make_pair(CacheKey(setIndex, victim->tag), victim);
 }
 
 void Cache::insertLine(int setIndex, uint32_t tag, uint64_t cycle, bool isWrite, CacheState initialState) {
-    CacheKey key(setIndex, tag);
-    auto& lruList = lruLists[setIndex];
-    auto& cacheMap = cacheMaps[setIndex];
+    CacheLine* set = &lines[static_cast<size_t>(setIndex) * E];
+    uint32_t* tagRow = tags + static_cast<size_t>(setIndex) * tagStride;
     
     // If we're updating an existing line, no need to evict anything
-    auto it = cacheMap.find(key);
-    if (it != cacheMap.end()) {
-        // Update existing line's state and timestamp
-        it->second.first.valid = true;
-        it->second.first.state = initialState;
-        it->second.first.lastUsedCycle = cycle;
-        
-        // Update LRU position
-        lruList.erase(it->second.second);
-        lruList.push_front(key);
-        it->second.second = lruList.begin();
-        return;
-    }
-    
-    // If the set is full, evict the LRU (least recently used) item
-    if (cacheMap.size() >= static_cast<size_t>(E)) {
-        CacheKey victimKey = lruList.back();
-        cacheMap.erase(victimKey);  // Remove from map
-        lruList.pop_back();         // Remove from LRU list
+    int way = findWay(setIndex, tag);
+    if (way < 0) {
+        if (setFill[setIndex] < E) {
+            // Fill the next empty way
+            way = setFill[setIndex]++;
+        } else {
+            // The set is full, replace the LRU (least recently used) line
+            way = 0;
+            for (int w = 1; w < E; w++) {
+                if (set[w].lruStamp < set[way].lruStamp)
+                    way = w;
+            }
+        }
+        set[way].tag = tag;
+        tagRow[way] = tag;
     }
     
-    // Create a new cache line with the provided state and timestamp
-    CacheLine newLine;
-    newLine.valid = true;
-    newLine.tag = tag;
-    newLine.state = initialState;
-    newLine.lastUsedCycle = cycle;
-    
-    // Add to front of LRU list (most recently used position)
-    lruList.push_front(key);
+    // Set state and move to the most recently used position
+    set[way].valid = true;
+    set[way].prefetched = false;
+    set[way].readyCycle = cycle;
+    setState(set[way], initialState);
+    touch(set[way], cycle);
+}
+
+void Cache::setState(CacheLine& line, CacheState next) {
+    if (line.state != next)
+        transitions[line.state][next]++;
+    line.state = next;
     
-    // Add to map with reference to its position in the LRU list
-    cacheMap[key] = {newLine, lruList.begin()};
+    // A prefetched block lost before any demand use was wasted
+    if (next == INVALID && line.prefetched) {
+        line.prefetched = false;
+        prefetcher->useless++;
+    }
 }
 
 void Cache::accessCache(bool isWrite, uint32_t address, uint64_t cycle, int coreId, Bus& bus, std::vector<Core*>& cores) {
+    switch (protocol) {
+        case PROTOCOL_MOESI:
+            access<MoesiPolicy>(isWrite, address, cycle, coreId, bus, cores);
+            break;
+        case PROTOCOL_MESIF:
+            access<MesifPolicy>(isWrite, address, cycle, coreId, bus, cores);
+            break;
+        default:
+            access<MesiPolicy>(isWrite, address, cycle, coreId, bus, cores);
+            break;
+    }
+}
+
+template <class Policy>
+void Cache::access(bool isWrite, uint32_t address, uint64_t cycle, int coreId, Bus& bus, std::vector<Core*>& cores) {
     // Extract set index and tag from address
     uint32_t setIndex = (address >> b) & ((1 << s) - 1);
     uint32_t tag = address >> (s + b);
     uint64_t haltcycles = 0;
     
-    // Try to find the cache line in our hashmap-based cache
+    // Try to find the cache line in our set-based cache
     CacheLine* cacheLine = findLine(setIndex, tag);
     
     if (cacheLine != nullptr) {
         // Cache hit handling
         Core *core = cores[coreId];
         
+        // A block still being filled for one of our MSHRs has no data yet: the
+        // access merges into that miss and is counted as a miss, not a hit
+        int merged = -1;
+        if (!mshrs.empty() && cycle < cacheLine->readyCycle)
+            merged = findIssuedMshr(address, cacheLine->readyCycle);
+        
         if (isWrite) {
-            // Write hit cases based on MESI protocol
+            // Write hit cases based on the coherence protocol
             
-            // Case 1: Writing to a SHARED line requires bus access to invalidate other copies
-            if (cacheLine->state == SHARED && bus.isbusy) {
-                // Bus is busy, must wait
-                idleCycles++;
+            // Case 1: Writing to a shared copy requires bus access to invalidate other copies
+            if (Policy::needsUpgrade(cacheLine->state) && bus.isbusy) {
+                // Bus is busy, wait in the arbitration queue
+                bus.requestBus(coreId, cycle, cores);
                 return;
             }
-            else if (cacheLine->state == SHARED && !bus.isbusy) {
+            else if (Policy::needsUpgrade(cacheLine->state)) {
                 // Bus is free, invalidate other copies and upgrade to MODIFIED
+                noteSharing(bus, coreId, address, true, cores);
                 bus.busUpgrade(coreId, address, cores, s, b);
-                cacheLine->state = MODIFIED;
+                logEvent(bus, cycle, coreId, EV_BUS_UPGRADE, address, cacheLine->state, MODIFIED, -1);
+                setState(*cacheLine, MODIFIED);
                 invalidations++;
                 core->execycles += 1;  // One cycle for write
                 core->instPtr++;
                 updateLRU(setIndex, tag, cycle);
-                writeHits++;
+                countHit(true, address, merged);
             }
             // Case 2: Writing to an EXCLUSIVE line - silent upgrade to MODIFIED
             else if (cacheLine->state == EXCLUSIVE) {
-                cacheLine->state = MODIFIED;
+                setState(*cacheLine, MODIFIED);
                 core->execycles += 1;
                 core->instPtr++;
                 updateLRU(setIndex, tag, cycle);
-                writeHits++;
+                countHit(true, address, merged);
             }
             // Case 3: Writing to a MODIFIED line
             else if (cacheLine->state == MODIFIED) {
                 // Line is already modified, just update timestamp
                 // In reality we'd need to write back eventually
-                cacheLine->state = MODIFIED;
                 core->execycles += 1;  // 1 cycle for hit + 100 for writeback
                 // haltcycles += 100;
                 core->instPtr++;
                 // trafficBytes += (1 << b);  // Count traffic from writeback
                 // bus.trafficBytes += (1 << b);
                 updateLRU(setIndex, tag, cycle);
-                writeHits++;
+                countHit(true, address, merged);
                 // writeBacks++;
                 // bus.isbusy = true;
                 // bus.moreleft = false;
@@ -179,20 +204,41 @@ void Cache::accessCache(bool isWrite, uint32_t address, uint64_t cycle, int core
             }
         } else {
             // Read hit is simpler - just update stats and LRU
-            readHits++;
+            countHit(false, address, merged);
             core->execycles += 1;  // One cycle for read hit
             core->instPtr++;
             updateLRU(setIndex, tag, cycle);
         }
+        
+        // The block may still be in flight: a blocking core waits for it, while a
+        // non-blocking one lets the access retire into the fill's MSHR (counted above)
+        bool inFlight = cycle < cacheLine->readyCycle;
+        bool firstUse = cacheLine->prefetched;
+        if (firstUse) {
+            cacheLine->prefetched = false;
+            prefetcher->useful++;
+            if (inFlight)
+                prefetcher->late++;
+        }
+        if (inFlight && mshrs.empty()) {
+            haltcycles += cacheLine->readyCycle - cycle;
+            idleCycles += cacheLine->readyCycle - cycle;
+        }
+        if (prefetcher)
+            prefetcher->observe(address, false, firstUse);
         core->nextFreeCycle = cycle + haltcycles;
         return;
     }
 
     // Cache miss handling
+    if (!mshrs.empty()) {
+        nonBlockingMiss<Policy>(isWrite, address, cycle, coreId, bus, cores);
+        return;
+    }
     
-    // If the bus is busy, we have to wait
+    // If the bus is busy, we have to wait in the arbitration queue
     if (bus.isbusy) {
-        idleCycles++;
+        bus.requestBus(coreId, cycle, cores);
         return;
     }
 
@@ -200,208 +246,598 @@ void Cache::accessCache(bool isWrite, uint32_t address, uint64_t cycle, int core
     std::pair<CacheKey, CacheLine*> replacement = findReplacement(setIndex, cycle);
     CacheLine* victim = replacement.second;
     
-    // Handle eviction if needed
-    if (victim != nullptr && victim->state != INVALID) {
-        evictions++;
-        uint32_t victimTag = victim->tag;
-        uint32_t victimAddress = (victimTag << (s + b)) | (setIndex << b);
+    // A dirty victim is written back first; the miss is retried once the bus frees up
+    uint64_t writeback = 0;
+    if (victim != nullptr && victim->state != INVALID)
+        writeback = evict<Policy>(*victim, setIndex, cycle, coreId, bus, cores);
+    if (writeback > 0) {
         Core *core = cores[coreId];
-        
-        // Handle eviction based on MESI state
-        switch (victim->state) {
-            case MODIFIED:
-                // MODIFIED line requires writeback to memory
-                writeBacks++;
-                haltcycles += 100;  // 100 cycles penalty for writeback
-                core->execycles += 100;
-                trafficBytes += (1 << b);  // Count traffic for writeback
-                bus.trafficBytes += (1 << b);
-                bus.isbusy = true;
-                bus.coreid = coreId;
-                victim->state = INVALID;  // Invalidate the line
-                bus.moreleft = true;      // More processing needed
-                bus.freeCycle = cycle + 100;
-                core->nextFreeCycle = cycle + haltcycles;
-                return;  // Return and come back later after writeback
-                
-            case SHARED:
-                // For SHARED lines, check if other caches have copies
-                {
-                    int sharedCount = 0;
-                    Core* lastCore = nullptr;
-                    bus.busTransactions++;
-
-                    // Count other cores with this line in SHARED state
-                    for (Core* otherCore : cores) {
-                        if (otherCore->id == coreId) continue;
-                        
-                        uint32_t otherSetIndex = (victimAddress >> b) & ((1 << s) - 1);
-                        uint32_t otherTag = victimAddress >> (s + b);
-                        
-                        CacheLine* otherLine = otherCore->cache->findLine(otherSetIndex, otherTag);
-                        if (otherLine != nullptr && otherLine->state == SHARED) {
-                            sharedCount++;
-                            lastCore = otherCore;
-                        }
-                    }
-                    
-                    // If only one other cache has the line, it can be upgraded to EXCLUSIVE
-                    if (sharedCount == 1 && lastCore != nullptr) {
-                        uint32_t otherSetIndex = (victimAddress >> b) & ((1 << s) - 1);
-                        uint32_t otherTag = victimAddress >> (s + b);
-                        
-                        CacheLine* otherLine = lastCore->cache->findLine(otherSetIndex, otherTag);
-                        if (otherLine != nullptr && otherLine->state == SHARED) {
-                            otherLine->state = EXCLUSIVE;
-                        }
-                    }
-                    victim->state = INVALID;
-                    // If multiple caches have copies, they remain in SHARED state
-                }
-                break;
-                
-            case EXCLUSIVE:
-                // EXCLUSIVE line doesn't need writeback (it's clean)
-                victim->state = INVALID;
-                break;
-                
-            default:
-                break;
-        }
+        haltcycles += writeback;  // Penalty for the writeback
+        core->execycles += writeback;
+        bus.isbusy = true;
+        bus.coreid = coreId;
+        bus.moreleft = true;      // More processing needed
+        bus.freeCycle = cycle + writeback;
+        core->nextFreeCycle = cycle + haltcycles;
+        return;  // Return and come back later after writeback
     }
 
     // Handle the actual miss operation
     if (!isWrite) {
-        handleReadMiss(coreId, address, cycle, bus, cores, haltcycles);
+        handleReadMiss<Policy>(coreId, address, cycle, bus, cores, haltcycles);
     } else {
-        handleWriteMiss(coreId, address, cycle, bus, cores, haltcycles);
+        handleWriteMiss<Policy>(coreId, address, cycle, bus, cores, haltcycles);
     }
 }
 
-void Cache::handleReadMiss(int coreId, uint64_t address, uint64_t cycle, Bus& bus, std::vector<Core*>& cores, uint64_t haltcycles) {
+template <class Policy>
+uint64_t Cache::evict(CacheLine& victim, uint32_t setIndex, uint64_t cycle, int coreId, Bus& bus, std::vector<Core*>& cores) {
+    evictions++;
+    uint32_t victimAddress = (victim.tag << (s + b)) | (setIndex << b);
+    logEvent(bus, cycle, coreId, EV_EVICTION, victimAddress, victim.state, INVALID, -1);
+    
+    // Handle eviction based on the victim's state
+    if (Policy::dirty(victim.state)) {
+        // Dirty line requires writeback; the caller charges the returned bus time
+        writeBacks++;
+        logEvent(bus, cycle, coreId, EV_WRITEBACK, victimAddress, victim.state, INVALID, -1);
+        trafficBytes += (1 << b);  // Count traffic for writeback
+        bus.trafficBytes += (1 << b);
+        setState(victim, INVALID);
+        return bus.writeBackBlock(victimAddress);
+    }
+    if (victim.state == SHARED || victim.state == FORWARD) {
+        releaseShared(victim, victimAddress, coreId, bus, cores);
+    }
+    else {
+        // EXCLUSIVE line doesn't need writeback (it's clean)
+        setState(victim, INVALID);
+    }
+    return 0;
+}
+
+void Cache::releaseShared(CacheLine& victim, uint32_t victimAddress, int coreId, Bus& bus, std::vector<Core*>& cores) {
+    // For shared lines, check if other caches have copies
+    int copies = 0;
+    CacheLine* lastLine = nullptr;
+    Core* lastCore = nullptr;
+    bus.busTransactions++;
+
+    // Count every other valid copy, dirty owners included
+    uint32_t otherSetIndex = (victimAddress >> b) & ((1 << s) - 1);
+    uint32_t otherTag = victimAddress >> (s + b);
+    for (Core* otherCore : cores) {
+        if (otherCore->id == coreId) continue;
+        
+        CacheLine* otherLine = otherCore->cache->findLine(otherSetIndex, otherTag);
+        if (otherLine != nullptr) {
+            copies++;
+            lastLine = otherLine;
+            lastCore = otherCore;
+        }
+    }
+    
+    // A clean copy left on its own can be upgraded to EXCLUSIVE; one next to an
+    // OWNED copy stays shared, or a silent E->M upgrade would lose the owner's data
+    if (copies == 1 && (lastLine->state == SHARED || lastLine->state == FORWARD)) {
+        lastCore->cache->setState(*lastLine, EXCLUSIVE);
+    }
+    setState(victim, INVALID);
+    // If multiple caches have copies, they remain shared
+}
+
+bool Cache::needsBus(bool isWrite, uint32_t address) {
+    uint32_t setIndex = (address >> b) & ((1 << s) - 1);
+    CacheLine* line = findLine(setIndex, address >> (s + b));
+    if (line == nullptr)
+        return true;
+    if (!isWrite)
+        return false;
+    switch (protocol) {
+        case PROTOCOL_MOESI: return MoesiPolicy::needsUpgrade(line->state);
+        case PROTOCOL_MESIF: return MesifPolicy::needsUpgrade(line->state);
+        default:             return MesiPolicy::needsUpgrade(line->state);
+    }
+}
+
+bool Cache::invalidateForInclusion(uint32_t address, uint64_t cycle, int coreId, Bus& bus, bool& dirty) {
+    uint32_t setIndex = (address >> b) & ((1 << s) - 1);
+    CacheLine* line = findLine(setIndex, address >> (s + b));
+    if (line == nullptr)
+        return false;
+    
+    switch (protocol) {
+        case PROTOCOL_MOESI: dirty = backInvalidate<MoesiPolicy>(*line, address, cycle, coreId, bus); break;
+        case PROTOCOL_MESIF: dirty = backInvalidate<MesifPolicy>(*line, address, cycle, coreId, bus); break;
+        default:             dirty = backInvalidate<MesiPolicy>(*line, address, cycle, coreId, bus); break;
+    }
+    return true;
+}
+
+template <class Policy>
+bool Cache::backInvalidate(CacheLine& line, uint32_t address, uint64_t cycle, int coreId, Bus& bus) {
+    // Same bookkeeping as losing the line to a remote write: a dirty copy is
+    // written back over the bus, and the classifier learns why it went
+    bool dirty = Policy::dirty(line.state);
+    if (dirty) {
+        writeBacks++;
+        logEvent(bus, cycle, coreId, EV_WRITEBACK, address, line.state, INVALID, -1);
+        trafficBytes += (1 << b);
+        bus.trafficBytes += (1 << b);
+    }
+    logEvent(bus, cycle, coreId, EV_BACK_INVALIDATE, address, line.state, INVALID, -1);
+    setState(line, INVALID);
+    backInvalidatedBy(address);
+    backInvalidations++;
+    return dirty;
+}
+
+template <class Policy>
+bool Cache::prefetch(uint32_t address, uint64_t cycle, int coreId, Bus& bus, std::vector<Core*>& cores) {
+    uint32_t setIndex = (address >> b) & ((1 << s) - 1);
+    uint32_t tag = address >> (s + b);
+    
+    // Already cached or waiting for the bus as a demand miss: nothing to do
+    if (findLine(setIndex, tag) != nullptr || findQueuedMshr(address) >= 0)
+        return false;
+    
+    // Never force a writeback for a speculative fill, ours or another core's
+    CacheLine* victim = findReplacement(setIndex, cycle).second;
+    if (victim != nullptr && Policy::dirty(victim->state)) {
+        prefetcher->dropped++;
+        return false;
+    }
+    Core* supplierCore = nullptr;
+    int bestRank = -1;
+    for (Core* core : cores) {
+        if (core->id == coreId) continue;
+        CacheLine* line = core->cache->findLine(setIndex, tag);
+        if (line == nullptr) continue;
+        if (Policy::dirty(line->state)) {
+            prefetcher->dropped++;
+            return false;
+        }
+        int rank = Policy::supplyRank(line->state);
+        if (rank >= 0 && (bestRank < 0 || rank < bestRank)) {
+            bestRank = rank;
+            supplierCore = core;
+        }
+    }
+    // Nor take a live block from any L1 to make room for it in the L2
+    if (supplierCore == nullptr && bus.fetchWouldBackInvalidate(address, cores)) {
+        prefetcher->dropped++;
+        return false;
+    }
+    
+    // Clean victim: evict it the same way a demand miss would
+    if (victim != nullptr && victim->state != INVALID)
+        evict<Policy>(*victim, setIndex, cycle, coreId, bus, cores);
+    
+    Bus::BusResult res = bus.busRd(coreId, address, cores, s, b);
+    uint64_t latency;
+    if (supplierCore != nullptr) {
+        latency = 2 * (1 << b) / 4;
+        supplierCore->cache->trafficBytes += (1 << b);
+    }
+    else {
+        latency = bus.fetchBlock(address, cycle, cores);
+    }
+    if (res != Bus::NO_DATA) {
+        for (Core* other : cores) {
+            if (other->id == coreId) continue;
+            CacheLine* line = other->cache->findLine(setIndex, tag);
+            if (line != nullptr)
+                other->cache->setState(*line, Policy::remoteRead(line->state));
+        }
+    }
+    
+    bus.isbusy = true;
+    bus.prefetchTenure = true;
+    bus.coreid = coreId;
+    bus.freeCycle = cycle + latency;
+    bus.trafficBytes += (1 << b);
+    trafficBytes += (1 << b);
+    prefetcher->issued++;
+    prefetcher->trafficBytes += (1 << b);
+    
+    CacheState fillState = Policy::readFill(res != Bus::NO_DATA);
+    logEvent(bus, cycle, coreId, EV_PREFETCH, address, INVALID, fillState,
+             supplierCore ? supplierCore->id : -1);
+    insertLine(setIndex, tag, cycle + latency, false, fillState);
+    findLine(setIndex, tag)->prefetched = true;
+    return true;
+}
+
+bool Cache::issuePrefetch(uint64_t cycle, int coreId, Bus& bus, std::vector<Core*>& cores) {
+    while (prefetcher && !prefetcher->queue.empty() && !bus.isbusy) {
+        uint32_t address = prefetcher->queue.front();
+        prefetcher->queue.pop_front();
+        
+        bool issued;
+        switch (protocol) {
+            case PROTOCOL_MOESI: issued = prefetch<MoesiPolicy>(address, cycle, coreId, bus, cores); break;
+            case PROTOCOL_MESIF: issued = prefetch<MesifPolicy>(address, cycle, coreId, bus, cores); break;
+            default:             issued = prefetch<MesiPolicy>(address, cycle, coreId, bus, cores); break;
+        }
+        if (issued)
+            return true;
+    }
+    return false;
+}
+
+template <class Policy>
+uint64_t Cache::busRead(int coreId, uint32_t address, uint64_t cycle, Bus& bus, std::vector<Core*>& cores, CacheState& fillState) {
     uint32_t setIndex = (address >> b) & ((1 << s) - 1);
     uint32_t tag = address >> (s + b);
-    CacheState finalState = INVALID;
+    int supplier = -1;
+    uint64_t latency;
     
+    noteSharing(bus, coreId, address, false, cores);
     Bus::BusResult res = bus.busRd(coreId, address, cores, s, b);
+    fillState = Policy::readFill(res != Bus::NO_DATA);
     
-    if (res == Bus::SHARED_DATA || res == Bus::EXCLUSIVE_DATA) {
-        finalState = SHARED;
-        // Find other cores with this line
+    // Pick the copy that answers the read, if the protocol lets any of them
+    Core* supplierCore = nullptr;
+    CacheLine* supplierLine = nullptr;
+    if (res != Bus::NO_DATA) {
+        int bestRank = -1;
         for (Core* core : cores) {
             if (core->id == coreId) continue;
             
             CacheLine* line = core->cache->findLine(setIndex, tag);
-            if (line != nullptr && (line->state == SHARED || line->state == EXCLUSIVE)) {
-                line->state = SHARED;
-                core->cache->trafficBytes += (1 << b);
-                break;
+            int rank = (line != nullptr) ? Policy::supplyRank(line->state) : -1;
+            if (rank >= 0 && (bestRank < 0 || rank < bestRank)) {
+                bestRank = rank;
+                supplierCore = core;
+                supplierLine = line;
             }
         }
-        
-        Core *core = cores[coreId];
-        core->execycles += (2 * (1 << b) / 4);
-        haltcycles += (2 * (1 << b) / 4);
+    }
+    
+    if (supplierCore != nullptr) {
+        // Cache-to-cache transfer
+        supplier = supplierCore->id;
+        supplierCore->cache->trafficBytes += (1 << b);
+        latency = 2 * (1 << b) / 4;
         bus.isbusy = true;
-        bus.freeCycle = cycle + haltcycles;
-        bus.trafficBytes += (1 << b);
-        trafficBytes += (1 << b);
-    } 
-    else if (res == Bus::MODIFIED_DATA) {
-        finalState = SHARED;
+        bus.freeCycle = cycle + latency;
         
-        for (Core* core : cores) {
-            if (core->id == coreId) continue;
-            
-            CacheLine* line = core->cache->findLine(setIndex, tag);
-            if (line != nullptr && line->state == MODIFIED) {
-                line->state = SHARED;
-                core->cache->trafficBytes += (1 << b);
-                core->cache->writeBacks++;
-                break;
-            }
+        if (Policy::writebackOnSupply(supplierLine->state)) {
+            // The supplier writes the block back to memory, holding the bus
+            supplierCore->cache->writeBacks++;
+            logEvent(bus, cycle, supplier, EV_WRITEBACK, address, supplierLine->state,
+                     Policy::remoteRead(supplierLine->state), -1);
+            bus.freeCycle += bus.writeBackBlock(address);
         }
-        
-        haltcycles += (2 * (1 << b) / 4);
-        Core *core = cores[coreId];
-        core->execycles += (2 * (1 << b) / 4);
-        bus.isbusy = true;
-        bus.freeCycle = cycle + haltcycles + 100;
         bus.trafficBytes += (1 << b);
         trafficBytes += (1 << b);
     } 
     else {
-        finalState = EXCLUSIVE;
-        Core *core = cores[coreId];
-        core->execycles += 100;
-        haltcycles += 100;
+        // Fetched from the L2 or memory
+        latency = bus.fetchBlock(address, cycle, cores);
         bus.isbusy = true;
-        bus.freeCycle = cycle + haltcycles;
+        bus.freeCycle = cycle + latency;
         bus.trafficBytes += (1 << b);
         trafficBytes += (1 << b);
     }
-
-    Core *core = cores[coreId];
-    core->nextFreeCycle = cycle + haltcycles;
-    core->execycles += 1;
-    readMisses++;
-    insertLine(setIndex, tag, cycle + haltcycles, false, finalState);
-    core->instPtr++;
+    
+    // Every remote copy observes the read
+    if (res != Bus::NO_DATA) {
+        for (Core* other : cores) {
+            if (other->id == coreId) continue;
+            CacheLine* line = other->cache->findLine(setIndex, tag);
+            if (line != nullptr)
+                other->cache->setState(*line, Policy::remoteRead(line->state));
+        }
+    }
+    
+    logEvent(bus, cycle, coreId, EV_BUS_RD, address, INVALID, fillState, supplier);
+    return latency;
 }
 
-void Cache::handleWriteMiss(int coreId, uint64_t address, uint64_t cycle, Bus& bus, std::vector<Core*>& cores, uint64_t haltcycles) {
+template <class Policy>
+uint64_t Cache::busReadExclusive(int coreId, uint32_t address, uint64_t cycle, Bus& bus, std::vector<Core*>& cores) {
     uint32_t setIndex = (address >> b) & ((1 << s) - 1);
     uint32_t tag = address >> (s + b);
+    uint64_t flush = 0;
     
+    noteSharing(bus, coreId, address, true, cores);
     Bus::BusResult res = bus.busRd(coreId, address, cores, s, b);
     
-    if (res == Bus::SHARED_DATA || res == Bus::EXCLUSIVE_DATA) {
+    if (res != Bus::NO_DATA) {
+        // Invalidate every other copy; dirty ones are written back first
+        bool dirtyCopy = false;
         invalidations++;
         
         for (Core* core : cores) {
             if (core->id == coreId) continue;
             
             CacheLine* line = core->cache->findLine(setIndex, tag);
-            if (line != nullptr && (line->state == SHARED || line->state == EXCLUSIVE)) {
-                line->state = INVALID;
-            }
-        }
-    } 
-    else if (res == Bus::MODIFIED_DATA) {
-        invalidations++;
-        
-        for (Core* core : cores) {
-            if (core->id == coreId) continue;
+            if (line == nullptr) continue;
             
-            CacheLine* line = core->cache->findLine(setIndex, tag);
-            if (line != nullptr && line->state == MODIFIED) {
-                line->state = INVALID;
+            if (Policy::dirty(line->state)) {
+                dirtyCopy = true;
                 core->cache->writeBacks++;
+                logEvent(bus, cycle, core->id, EV_WRITEBACK, address, line->state, INVALID, -1);
                 core->cache->trafficBytes += (1 << b);
             }
+            core->cache->setState(*line, INVALID);
+            core->cache->invalidatedBy(address);
         }
         
-        idleCycles += 100;    
-        haltcycles += 100;  
-        bus.isbusy = true;
-        bus.trafficBytes += (1 << b);
+        if (dirtyCopy) {
+            flush = bus.writeBackBlock(address);
+            bus.isbusy = true;
+            bus.trafficBytes += (1 << b);
+        }
     }
 
+    bus.freeCycle = cycle + flush;
+    trafficBytes += (1 << b);
+    logEvent(bus, cycle, coreId, EV_BUS_RDX, address, INVALID, MODIFIED, -1);
+    return flush;
+}
+
+template <class Policy>
+void Cache::handleReadMiss(int coreId, uint64_t address, uint64_t cycle, Bus& bus, std::vector<Core*>& cores, uint64_t haltcycles) {
+    uint32_t setIndex = (address >> b) & ((1 << s) - 1);
+    uint32_t tag = address >> (s + b);
+    
+    CacheState finalState;
+    uint64_t latency = busRead<Policy>(coreId, address, cycle, bus, cores, finalState);
+    Core *core = cores[coreId];
+    core->execycles += latency;
+    haltcycles += latency;
+
+    core->nextFreeCycle = cycle + haltcycles;
+    core->execycles += 1;
+    readMisses++;
+    recordMiss(address);
+    insertLine(setIndex, tag, cycle + haltcycles, false, finalState);
+    core->instPtr++;
+    if (prefetcher)
+        prefetcher->observe(address, true, false);
+}
+
+template <class Policy>
+void Cache::handleWriteMiss(int coreId, uint64_t address, uint64_t cycle, Bus& bus, std::vector<Core*>& cores, uint64_t haltcycles) {
+    uint32_t setIndex = (address >> b) & ((1 << s) - 1);
+    uint32_t tag = address >> (s + b);
+    
+    // Remote dirty copies hold us up while they are written back
+    uint64_t flush = busReadExclusive<Policy>(coreId, address, cycle, bus, cores);
+    idleCycles += flush;
+    haltcycles += flush;
+
     Core *core = cores[coreId];
-    bus.freeCycle = cycle + haltcycles;
-    haltcycles += 100;
-    core->execycles += 100;
+    uint64_t fetch = bus.fetchBlock(address, cycle + flush, cores);
+    haltcycles += fetch;
+    core->execycles += fetch;
     core->execycles += 1;
     core->nextFreeCycle = cycle + haltcycles;
-    trafficBytes += (1 << b);
     
     insertLine(setIndex, tag, cycle + haltcycles, true, MODIFIED);
     writeMisses++;
+    recordMiss(address);
+    core->instPtr++;
+    if (prefetcher)
+        prefetcher->observe(address, true, false);
+}
+
+template <class Policy>
+void Cache::nonBlockingMiss(bool isWrite, uint32_t address, uint64_t cycle, int coreId, Bus& bus, std::vector<Core*>& cores) {
+    Core* core = cores[coreId];
+    retireMshrs(cycle);
+    
+    // Secondary miss on a block still waiting for the bus: merge into its entry
+    int slot = findQueuedMshr(address);
+    if (slot >= 0) {
+        mshrs[slot].isWrite = mshrs[slot].isWrite || isWrite;
+        recordMerge(isWrite, slot);
+        core->execycles += 1;
+        core->instPtr++;
+        core->nextFreeCycle = cycle;
+        return;
+    }
+    
+    slot = -1;
+    for (size_t i = 0; i < mshrs.size() && slot < 0; i++) {
+        if (!mshrs[i].busy)
+            slot = static_cast<int>(i);
+    }
+    if (slot < 0) {
+        // Every MSHR is outstanding: stall until the earliest fill, or until the
+        // bus frees up if all of them are still queued for it. As in blocking
+        // mode, waiting for data is execution time and waiting for the bus is idle.
+        uint64_t wake = UINT64_MAX;
+        for (const MshrEntry& entry : mshrs) {
+            if (entry.issued)
+                wake = std::min(wake, entry.readyCycle);
+        }
+        bool waitingForBus = (wake == UINT64_MAX);
+        if (waitingForBus)
+            wake = bus.isbusy ? bus.freeCycle : cycle;
+        wake = std::max(wake, cycle);
+        mshrFullStalls += wake - cycle + 1;
+        if (waitingForBus)
+            idleCycles += wake - cycle + 1;
+        else
+            core->execycles += wake - cycle + 1;
+        core->nextFreeCycle = wake;
+        return;
+    }
+    
+    // Primary miss: the access retires now and the fill completes in the background
+    MshrEntry& entry = mshrs[slot];
+    entry = MshrEntry();
+    entry.busy = true;
+    entry.isWrite = isWrite;
+    entry.address = address;
+    entry.allocCycle = cycle;
+    mshrAllocations++;
+    uint64_t outstanding = 0;
+    for (const MshrEntry& other : mshrs)
+        outstanding += other.busy;
+    mshrPeak = std::max(mshrPeak, outstanding);
+    
+    if (isWrite)
+        writeMisses++;
+    else
+        readMisses++;
+    entry.missType = recordMiss(address);
+    core->execycles += 1;
     core->instPtr++;
+    core->nextFreeCycle = cycle;
+    if (prefetcher)
+        prefetcher->observe(address, true, false);
+    
+    if (bus.isbusy)
+        bus.queueMiss(coreId, slot, cycle, cores);
+    else
+        fillMshr<Policy>(slot, cycle, coreId, bus, cores);
+}
+
+template <class Policy>
+void Cache::fillMshr(int slot, uint64_t cycle, int coreId, Bus& bus, std::vector<Core*>& cores) {
+    MshrEntry& entry = mshrs[slot];
+    uint32_t setIndex = (entry.address >> b) & ((1 << s) - 1);
+    uint32_t tag = entry.address >> (s + b);
+    
+    // A dirty victim's writeback shares the bus tenure, ahead of the fill
+    uint64_t start = cycle;
+    CacheLine* victim = findReplacement(setIndex, cycle).second;
+    if (victim != nullptr && victim->state != INVALID)
+        start += evict<Policy>(*victim, setIndex, cycle, coreId, bus, cores);
+    
+    uint64_t ready;
+    CacheState fillState = MODIFIED;
+    if (entry.isWrite) {
+        ready = start + busReadExclusive<Policy>(coreId, entry.address, start, bus, cores);
+        ready += bus.fetchBlock(entry.address, ready, cores);
+    }
+    else
+        ready = start + busRead<Policy>(coreId, entry.address, start, bus, cores, fillState);
+    if (start > cycle)
+        bus.isbusy = true;
+    
+    insertLine(setIndex, tag, ready, entry.isWrite, fillState);
+    entry.issued = true;
+    entry.readyCycle = ready;
+    lastFillCycle = std::max(lastFillCycle, ready);
+}
+
+void Cache::issueMshr(int slot, uint64_t cycle, int coreId, Bus& bus, std::vector<Core*>& cores) {
+    switch (protocol) {
+        case PROTOCOL_MOESI: fillMshr<MoesiPolicy>(slot, cycle, coreId, bus, cores); break;
+        case PROTOCOL_MESIF: fillMshr<MesifPolicy>(slot, cycle, coreId, bus, cores); break;
+        default:             fillMshr<MesiPolicy>(slot, cycle, coreId, bus, cores); break;
+    }
+}
+
+int Cache::findQueuedMshr(uint32_t address) {
+    for (size_t i = 0; i < mshrs.size(); i++) {
+        if (mshrs[i].busy && !mshrs[i].issued && (mshrs[i].address >> b) == (address >> b))
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+int Cache::findIssuedMshr(uint32_t address, uint64_t readyCycle) {
+    for (size_t i = 0; i < mshrs.size(); i++) {
+        if (mshrs[i].busy && mshrs[i].issued && mshrs[i].readyCycle == readyCycle &&
+            (mshrs[i].address >> b) == (address >> b))
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void Cache::recordMerge(bool isWrite, int slot) {
+    // A secondary miss finds no data either; it takes the primary miss's category
+    mshrMerges++;
+    if (isWrite)
+        writeMisses++;
+    else
+        readMisses++;
+    countMiss(mshrs[slot].missType);
+}
+
+void Cache::retireMshrs(uint64_t cycle) {
+    for (MshrEntry& entry : mshrs) {
+        if (entry.busy && entry.issued && entry.readyCycle <= cycle) {
+            entry.busy = false;
+            mshrBusyCycles += entry.readyCycle - entry.allocCycle;
+        }
+    }
+}
+
+uint64_t Cache::drainMshrs(uint64_t lastCycle) {
+    retireMshrs(UINT64_MAX);
+    return lastFillCycle > lastCycle ? lastFillCycle - lastCycle : 0;
+}
+
+void Cache::countHit(bool isWrite, uint32_t address, int merged) {
+    if (merged >= 0) {
+        recordMerge(isWrite, merged);
+        return;
+    }
+    if (isWrite)
+        writeHits++;
+    else
+        readHits++;
+    recordHit(address);
+}
+
+void Cache::recordHit(uint32_t address) {
+    classifier.hit(address);
+}
+
+MissType Cache::recordMiss(uint32_t address) {
+    MissType type = classifier.miss(address);
+    countMiss(type);
+    return type;
+}
+
+void Cache::countMiss(MissType type) {
+    switch (type) {
+        case COMPULSORY_MISS: compulsoryMisses++; break;
+        case CAPACITY_MISS:   capacityMisses++;   break;
+        case CONFLICT_MISS:   conflictMisses++;   break;
+        case COHERENCE_MISS:  coherenceMisses++;  break;
+        case INCLUSION_MISS:  inclusionMisses++;  break;
+    }
+}
+
+void Cache::invalidatedBy(uint32_t address) {
+    classifier.invalidated(address);
+}
+
+void Cache::backInvalidatedBy(uint32_t address) {
+    classifier.backInvalidated(address);
+}
+
+void Cache::logEvent(Bus& bus, uint64_t cycle, int coreId, EventType type, uint32_t address,
+                     CacheState prior, CacheState next, int supplier) {
+    if (bus.eventLog)
+        bus.eventLog->record(cycle, coreId, type, address >> b, prior, next, supplier);
+}
+
+void Cache::noteSharing(Bus& bus, int coreId, uint32_t address, bool isWrite, std::vector<Core*>& cores) {
+    if (!bus.sharing)
+        return;
+    
+    uint32_t setIndex = (address >> b) & ((1 << s) - 1);
+    uint32_t tag = address >> (s + b);
+    unsigned holders = 0;
+    for (Core* core : cores) {
+        if (core->id != coreId && core->cache->findLine(setIndex, tag) != nullptr)
+            holders |= 1u << core->id;
+    }
+    bus.sharing->coherenceEvent(coreId, address, isWrite, holders);
 }
 
 void Cache::busupdate(class Bus &bus) {
     bus.isbusy = false;
+    bus.prefetchTenure = false;
     bus.freeCycle = 0;
     bus.coreid = 0;
     bus.moreleft = false;
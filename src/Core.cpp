@@ -1,4 +1,5 @@
 #include "Core.hh"
+#include "TraceStream.hh"
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
@@ -6,9 +7,53 @@
 #include <string>
 #include <algorithm>
 
+Request::Request() : isWrite(false), address(0) {}
+
 Request::Request(bool isWrite, uint32_t address) : isWrite(isWrite), address(address) {}
 
-Core::Core(int id, Cache* cache) : id(id), cache(cache), instPtr(0), previnstr(0), nextFreeCycle(0), readCount(0), writeCount(0), execycles(0) {}
+Core::Core(int id, Cache* cache) : id(id), cache(cache), instPtr(0), previnstr(0), nextFreeCycle(0), readCount(0), writeCount(0), execycles(0), parked(false), parkedSince(0), reuse(nullptr), stream(nullptr), fetched(0) {}
+
+Core::~Core() {
+    delete stream;
+}
+
+bool parseTraceLine(const std::string& line, const std::string& filename, Request& out) {
+    // Skip empty lines or comment lines
+    if (line.empty() || line[0] == '#')
+        return false;
+        
+    // Extract operation character (R or W)
+    char op = line[0];
+    
+    // Validate operation type
+    if (op != 'R' && op != 'r' && op != 'W' && op != 'w') {
+        std::cerr << "Warning: Invalid operation in file " << filename << ": " << op << std::endl;
+        return false;
+    }
+    
+    // Find address part (everything after the operation character)
+    std::string addressPart = line.substr(1);
+    
+    // Trim whitespace from address part
+    addressPart.erase(0, addressPart.find_first_not_of(" \t\r\n"));
+    addressPart.erase(addressPart.find_last_not_of(" \t\r\n") + 1);
+    
+    // Remove '0x' prefix if present
+    if (addressPart.length() >= 2 && addressPart.substr(0, 2) == "0x") {
+        addressPart = addressPart.substr(2);
+    }
+    
+    // Convert hex string to integer
+    try {
+        out.address = std::stoul(addressPart, nullptr, 16);
+    } catch (const std::exception& e) {
+        std::cerr << "Error in file " << filename << ": Failed to convert '" 
+                  << addressPart << "' to address. Line: '" << line << "'" << std::endl;
+        return false;
+    }
+    out.isWrite = (op == 'W' || op == 'w');
+    return true;
+}
 
 void Core::loadTrace(const std::string& filename) {
     std::ifstream fin(filename);
@@ -18,53 +63,13 @@ void Core::loadTrace(const std::string& filename) {
     }
     
     std::string line;
+    Request req;
     while (getline(fin, line)) {
-        // Skip empty lines or comment lines
-        if (line.empty() || line[0] == '#')
-            continue;
-            
-        // Extract operation character (R or W)
-        if (line.length() < 1) continue;
-        char op = line[0];
-        
-        // Validate operation type
-        if (op != 'R' && op != 'r' && op != 'W' && op != 'w') {
-            std::cerr << "Warning: Invalid operation in file " << filename << ": " << op << std::endl;
+        if (!parseTraceLine(line, filename, req))
             continue;
-        }
-        
-        // Find address part (everything after the operation character)
-        std::string addressPart = line.substr(1);
-        
-        // Trim whitespace from address part
-        addressPart.erase(0, addressPart.find_first_not_of(" \t\r\n"));
-        addressPart.erase(addressPart.find_last_not_of(" \t\r\n") + 1);
-        
-        // Remove '0x' prefix if present
-        if (addressPart.length() >= 2 && addressPart.substr(0, 2) == "0x") {
-            addressPart = addressPart.substr(2);
-        }
-        
-        // Convert hex string to integer
-        uint32_t address;
-        try {
-            address = std::stoul(addressPart, nullptr, 16);
-        } catch (const std::exception& e) {
-            std::cerr << "Error in file " << filename << ": Failed to convert '" 
-                      << addressPart << "' to address. Line: '" << line << "'" << std::endl;
-            continue;
-        }
         
         // Add instruction to trace
-        bool isWrite = (op == 'W' || op == 'w');
-        trace.emplace_back(isWrite, address);
-        
-        // Update read/write counters
-        if (isWrite) {
-            writeCount++;
-        } else {
-            readCount++;
-        }
+        pushRequest(req);
     }
     
     fin.close();
@@ -73,3 +78,46 @@ void Core::loadTrace(const std::string& filename) {
         std::cerr << "Warning: No valid operations loaded from trace file: " << filename << std::endl;
     }
 }
+
+void Core::pushRequest(const Request& req) {
+    // Drop the performed prefix once it dominates, so callers that keep
+    // pushing while the simulation runs do not grow the trace without bound
+    if (instPtr >= 4096 && instPtr * 2 >= trace.size()) {
+        trace.erase(trace.begin(), trace.begin() + instPtr);
+        instPtr = 0;
+    }
+    
+    trace.push_back(req);
+    if (reuse)
+        reuse->access(req.address);
+    
+    // Update read/write counters
+    if (req.isWrite) {
+        writeCount++;
+    } else {
+        readCount++;
+    }
+}
+
+void Core::streamTrace(const std::string& filename) {
+    delete stream;
+    stream = new TraceStream(filename, reuse);
+}
+
+const Request* Core::currentRequest() {
+    if (!stream)
+        return instPtr < trace.size() ? &trace[instPtr] : nullptr;
+    
+    // instPtr advances one request at a time, so one buffered request suffices
+    if (fetched <= instPtr) {
+        if (!stream->next(current))
+            return nullptr;
+        fetched++;
+        if (current.isWrite) {
+            writeCount++;
+        } else {
+            readCount++;
+        }
+    }
+    return &current;
+}
@@ -0,0 +1,47 @@
+#include "EventLog.hh"
+#include <cstring>
+#include <iostream>
+
+EventLog::EventLog() : recorded(0), file(nullptr), failed(false), buffer(BUFFER_RECORDS), used(0) {}
+
+EventLog::~EventLog() {
+    close();
+}
+
+bool EventLog::open(const std::string& filename, int b) {
+    this->filename = filename;
+    file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error opening event log: " << filename << std::endl;
+        return false;
+    }
+    
+    EventLogHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "HCEVLOG1", 8);
+    header.version = VERSION;
+    header.recordSize = sizeof(EventRecord);
+    header.blockBits = b;
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        failed = true;
+    return true;
+}
+
+void EventLog::flush() {
+    if (file && used > 0 && fwrite(buffer.data(), sizeof(EventRecord), used, file) != used)
+        failed = true;
+    recorded += used;
+    used = 0;
+}
+
+bool EventLog::close() {
+    if (!file)
+        return !failed;
+    flush();
+    if (fclose(file) != 0)
+        failed = true;
+    file = nullptr;
+    if (failed)
+        std::cerr << "Error writing event log: " << filename << " is incomplete" << std::endl;
+    return !failed;
+}
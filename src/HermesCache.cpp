@@ -0,0 +1,141 @@
+#include "HermesCache.hh"
+#include "Simulator.hh"
+#include "Prefetcher.hh"
+#include <stdexcept>
+
+namespace {
+    ProtocolKind toProtocol(HermesProtocol protocol) {
+        switch (protocol) {
+            case HERMES_MOESI: return PROTOCOL_MOESI;
+            case HERMES_MESIF: return PROTOCOL_MESIF;
+            default:           return PROTOCOL_MESI;
+        }
+    }
+
+    PrefetcherKind toPrefetcher(HermesPrefetcher prefetcher) {
+        switch (prefetcher) {
+            case HERMES_PREFETCH_NEXT_LINE: return PREFETCH_NEXT_LINE;
+            case HERMES_PREFETCH_STRIDE:    return PREFETCH_STRIDE;
+            default:                        return PREFETCH_NONE;
+        }
+    }
+}
+
+int hermesCacheVersion() {
+    return HERMESCACHE_VERSION;
+}
+
+HermesConfig::HermesConfig()
+    : s(6), E(2), b(5), protocol(HERMES_MESI), prefetcher(HERMES_PREFETCH_NONE),
+      prefetchDegree(1), prefetchDistance(1), mshrs(0),
+      l2s(-1), l2E(8), l2b(6), l2HitLatency(20), l2Replacement(HERMES_L2_LRU),
+      arbitration(HERMES_ARBITRATION_RETRY) {}
+
+struct HermesCache::Impl {
+    Simulator sim;
+
+    explicit Impl(const HermesConfig& config)
+        : sim(config.s, config.E, config.b, toProtocol(config.protocol)) {
+        sim.setArbitration(config.arbitration == HERMES_ARBITRATION_FIFO ? ARBITRATION_FIFO : ARBITRATION_RETRY);
+        if (config.prefetcher != HERMES_PREFETCH_NONE && (config.prefetchDegree < 1 || config.prefetchDistance < 1))
+            throw std::invalid_argument("Prefetch degree and distance must be at least 1");
+        sim.enablePrefetcher(toPrefetcher(config.prefetcher), config.prefetchDegree, config.prefetchDistance);
+        sim.enableNonBlocking(config.mshrs);
+        L2Replacement replacement = config.l2Replacement == HERMES_L2_RANDOM ? L2_RANDOM : L2_LRU;
+        if (config.l2s >= 0 && !sim.enableL2(config.l2s, config.l2E, config.l2b, config.l2HitLatency, replacement))
+            throw std::invalid_argument("L2 blocks must be at least as large as L1 blocks");
+    }
+};
+
+HermesCache::HermesCache(const HermesConfig& config) : impl(new Impl(config)) {}
+
+HermesCache::~HermesCache() {
+    delete impl;
+}
+
+bool HermesCache::push(const HermesAccess* accesses, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (accesses[i].core >= NUM_CORES)
+            return false;
+    }
+    for (size_t i = 0; i < count; i++)
+        impl->sim.pushAccess(accesses[i].core, accesses[i].isWrite, accesses[i].address);
+    return true;
+}
+
+bool HermesCache::push(const std::vector<HermesAccess>& accesses) {
+    return push(accesses.data(), accesses.size());
+}
+
+bool HermesCache::step(uint64_t cycles) {
+    uint64_t target = impl->sim.currentCycle() + cycles;
+    while (impl->sim.currentCycle() < target) {
+        if (!impl->sim.step())
+            return false;
+    }
+    return true;
+}
+
+void HermesCache::drain() {
+    impl->sim.run();
+}
+
+HermesCoreStats HermesCache::coreStats(int core) const {
+    HermesCoreStats stats = HermesCoreStats();
+    if (core < 0 || core >= NUM_CORES)
+        return stats;
+
+    const Core* c = impl->sim.getCores()[core];
+    const Cache* cache = c->cache;
+    stats.reads = c->readCount;
+    stats.writes = c->writeCount;
+    stats.executionCycles = c->execycles;
+    stats.idleCycles = cache->idleCycles;
+    stats.readHits = cache->readHits;
+    stats.readMisses = cache->readMisses;
+    stats.writeHits = cache->writeHits;
+    stats.writeMisses = cache->writeMisses;
+    stats.compulsoryMisses = cache->compulsoryMisses;
+    stats.capacityMisses = cache->capacityMisses;
+    stats.conflictMisses = cache->conflictMisses;
+    stats.coherenceMisses = cache->coherenceMisses;
+    stats.inclusionMisses = cache->inclusionMisses;
+    stats.evictions = cache->evictions;
+    stats.writebacks = cache->writeBacks;
+    stats.invalidations = cache->invalidations;
+    stats.trafficBytes = cache->trafficBytes;
+    if (cache->prefetcher) {
+        stats.prefetchesIssued = cache->prefetcher->issued;
+        stats.usefulPrefetches = cache->prefetcher->useful;
+        stats.latePrefetches = cache->prefetcher->late;
+        stats.uselessPrefetches = cache->prefetcher->useless;
+    }
+    stats.mshrMerges = cache->mshrMerges;
+    stats.mshrFullStallCycles = cache->mshrFullStalls;
+    stats.backInvalidations = cache->backInvalidations;
+    stats.prefetchDelayCycles = cache->prefetchDelayCycles;
+    return stats;
+}
+
+HermesBusStats HermesCache::busStats() const {
+    HermesBusStats stats;
+    stats.transactions = impl->sim.getBus().busTransactions;
+    stats.trafficBytes = impl->sim.getBus().trafficBytes;
+    stats.cycle = impl->sim.currentCycle();
+    return stats;
+}
+
+HermesL2Stats HermesCache::l2Stats() const {
+    HermesL2Stats stats = HermesL2Stats();
+    const L2Cache* l2 = impl->sim.getL2();
+    if (!l2)
+        return stats;
+    stats.enabled = true;
+    stats.hits = l2->hits;
+    stats.misses = l2->misses;
+    stats.writebacks = l2->writebacks;
+    stats.backInvalidations = l2->backInvalidations;
+    stats.snoopsFiltered = l2->snoopsFiltered;
+    stats.inclusionViolations = l2->inclusionViolations;
+    return stats;
+}
@@ -0,0 +1,110 @@
+#include "L2Cache.hh"
+
+L2Cache::L2Cache(int s, int E, int b, uint64_t hitLatency, L2Replacement replacement)
+    : s(s), E(E), b(b), hitLatency(hitLatency), replacement(replacement),
+      hits(0), misses(0), writebacks(0), backInvalidations(0), snoopsFiltered(0), inclusionViolations(0),
+      lines(static_cast<size_t>(1 << s) * E), lruClock(0), rng(0x2545F491u) {}
+
+int L2Cache::findWay(uint32_t setIndex, uint32_t tag) const {
+    const Line* set = &lines[static_cast<size_t>(setIndex) * E];
+    for (int w = 0; w < E; w++) {
+        if (set[w].valid && set[w].tag == tag)
+            return w;
+    }
+    return -1;
+}
+
+bool L2Cache::contains(uint32_t address) const {
+    uint32_t setIndex = (address >> b) & ((1 << s) - 1);
+    uint32_t tag = address >> (s + b);
+    return findWay(setIndex, tag) >= 0;
+}
+
+int L2Cache::chooseVictim(const Line* set, uint32_t& state) const {
+    if (replacement == L2_RANDOM) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return static_cast<int>(state % E);
+    }
+    int way = 0;
+    for (int w = 1; w < E; w++) {
+        if (set[w].lruStamp < set[way].lruStamp)
+            way = w;
+    }
+    return way;
+}
+
+bool L2Cache::wouldDisplace(uint32_t address, uint32_t& victimAddress) const {
+    uint32_t setIndex = (address >> b) & ((1 << s) - 1);
+    if (findWay(setIndex, address >> (s + b)) >= 0)
+        return false;
+    const Line* set = &lines[static_cast<size_t>(setIndex) * E];
+    for (int w = 0; w < E; w++) {
+        if (!set[w].valid)
+            return false;
+    }
+    uint32_t state = rng;
+    int way = chooseVictim(set, state);
+    victimAddress = (set[way].tag << (s + b)) | (setIndex << b);
+    return true;
+}
+
+bool L2Cache::access(uint32_t address, bool dirty, L2Victim& victim) {
+    uint32_t setIndex = (address >> b) & ((1 << s) - 1);
+    uint32_t tag = address >> (s + b);
+    Line* set = &lines[static_cast<size_t>(setIndex) * E];
+    victim = L2Victim();
+
+    int way = findWay(setIndex, tag);
+    if (way >= 0) {
+        hits++;
+        set[way].dirty = set[way].dirty || dirty;
+        set[way].lruStamp = ++lruClock;
+        return true;
+    }
+    misses++;
+
+    // Prefer an empty way; otherwise displace one by the replacement policy
+    for (int w = 0; w < E && way < 0; w++) {
+        if (!set[w].valid)
+            way = w;
+    }
+    if (way < 0) {
+        way = chooseVictim(set, rng);
+        victim.valid = true;
+        victim.dirty = set[way].dirty;
+        victim.address = (set[way].tag << (s + b)) | (setIndex << b);
+    }
+
+    set[way].valid = true;
+    set[way].dirty = dirty;
+    set[way].tag = tag;
+    set[way].lruStamp = ++lruClock;
+    return false;
+}
+
+bool L2Cache::writeBack(uint32_t address) {
+    uint32_t setIndex = (address >> b) & ((1 << s) - 1);
+    int way = findWay(setIndex, address >> (s + b));
+    if (way < 0) {
+        inclusionViolations++;
+        return false;
+    }
+    Line& line = lines[static_cast<size_t>(setIndex) * E + way];
+    hits++;
+    line.dirty = true;
+    line.lruStamp = ++lruClock;
+    return true;
+}
+
+bool parseL2Replacement(const std::string& name, L2Replacement& replacement) {
+    if (name == "lru") replacement = L2_LRU;
+    else if (name == "random") replacement = L2_RANDOM;
+    else return false;
+    return true;
+}
+
+const char* l2ReplacementName(L2Replacement replacement) {
+    return replacement == L2_RANDOM ? "Random" : "LRU";
+}
@@ -0,0 +1,101 @@
+#include "MissClassifier.hh"
+
+MissClassifier::MissClassifier(size_t lines, int b)
+    : b(b), capacity(lines), head(NIL), tail(NIL) {
+    nodes.reserve(lines);
+    shadowIndex.reserve(lines);
+}
+
+void MissClassifier::unlink(uint32_t node) {
+    ShadowNode& n = nodes[node];
+    if (n.prev != NIL) nodes[n.prev].next = n.next; else head = n.next;
+    if (n.next != NIL) nodes[n.next].prev = n.prev; else tail = n.prev;
+}
+
+void MissClassifier::pushFront(uint32_t node) {
+    ShadowNode& n = nodes[node];
+    n.prev = NIL;
+    n.next = head;
+    if (head != NIL) nodes[head].prev = node;
+    head = node;
+    if (tail == NIL) tail = node;
+}
+
+bool MissClassifier::shadowAccess(uint32_t block) {
+    auto it = shadowIndex.find(block);
+    if (it != shadowIndex.end()) {
+        unlink(it->second);
+        pushFront(it->second);
+        return true;
+    }
+    
+    uint32_t node;
+    if (!freeNodes.empty()) {
+        node = freeNodes.back();
+        freeNodes.pop_back();
+    } else if (nodes.size() < capacity) {
+        node = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(ShadowNode());
+    } else {
+        // Full: recycle the least recently used node for the new block
+        node = tail;
+        unlink(node);
+        shadowIndex.erase(nodes[node].block);
+    }
+    nodes[node].block = block;
+    shadowIndex[block] = node;
+    pushFront(node);
+    return false;
+}
+
+bool MissClassifier::firstTouch(uint32_t block) {
+    std::vector<uint64_t>& page = touchedPages[block >> PAGE_BITS];
+    if (page.empty())
+        page.resize((1 << PAGE_BITS) / 64, 0);
+    
+    uint32_t bit = block & ((1 << PAGE_BITS) - 1);
+    uint64_t mask = 1ULL << (bit & 63);
+    bool unseen = (page[bit >> 6] & mask) == 0;
+    page[bit >> 6] |= mask;
+    return unseen;
+}
+
+void MissClassifier::hit(uint32_t address) {
+    shadowAccess(address >> b);
+}
+
+MissType MissClassifier::miss(uint32_t address) {
+    uint32_t block = address >> b;
+    bool shadowHit = shadowAccess(block);
+    
+    if (firstTouch(block))
+        return COMPULSORY_MISS;
+    if (coherenceLost.erase(block))
+        return COHERENCE_MISS;
+    if (inclusionLost.erase(block))
+        return INCLUSION_MISS;
+    return shadowHit ? CONFLICT_MISS : CAPACITY_MISS;
+}
+
+void MissClassifier::dropShadow(uint32_t block) {
+    auto it = shadowIndex.find(block);
+    if (it != shadowIndex.end()) {
+        unlink(it->second);
+        freeNodes.push_back(it->second);
+        shadowIndex.erase(it);
+    }
+}
+
+void MissClassifier::invalidated(uint32_t address) {
+    uint32_t block = address >> b;
+    inclusionLost.erase(block);
+    coherenceLost.insert(block);
+    dropShadow(block);
+}
+
+void MissClassifier::backInvalidated(uint32_t address) {
+    uint32_t block = address >> b;
+    coherenceLost.erase(block);
+    inclusionLost.insert(block);
+    dropShadow(block);
+}
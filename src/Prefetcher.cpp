@@ -0,0 +1,58 @@
+#include "Prefetcher.hh"
+#include <algorithm>
+
+Prefetcher::Prefetcher(PrefetcherKind kind, int b, int degree, int distance)
+    : kind(kind), degree(degree), distance(distance),
+      issued(0), useful(0), late(0), useless(0), dropped(0), trafficBytes(0),
+      b(b), lastBlock(0), lastStride(0), haveLast(false) {}
+
+void Prefetcher::propose(int64_t block) {
+    // Stay inside the 32-bit address space
+    if (block < 0 || block > (int64_t)(UINT32_MAX >> b))
+        return;
+    uint32_t address = static_cast<uint32_t>(block) << b;
+    if (std::find(queue.begin(), queue.end(), address) != queue.end())
+        return;
+    if (queue.size() >= MAX_QUEUE)
+        queue.pop_front();
+    queue.push_back(address);
+}
+
+void Prefetcher::observe(uint32_t address, bool miss, bool firstUse) {
+    uint32_t block = address >> b;
+    
+    if (kind == PREFETCH_NEXT_LINE) {
+        if (miss || firstUse) {
+            for (int i = 0; i < degree; i++)
+                propose((int64_t)block + distance + i);
+        }
+    } else if (kind == PREFETCH_STRIDE) {
+        // Prefetch once the same non-zero block stride is seen twice in a row
+        int64_t stride = haveLast ? (int64_t)block - lastBlock : 0;
+        if (stride != 0) {
+            if (stride == lastStride) {
+                for (int i = 0; i < degree; i++)
+                    propose((int64_t)block + stride * (distance + i));
+            }
+            lastStride = stride;
+        }
+        lastBlock = block;
+        haveLast = true;
+    }
+}
+
+bool parsePrefetcher(const std::string& name, PrefetcherKind& kind) {
+    if (name == "none") kind = PREFETCH_NONE;
+    else if (name == "nextline") kind = PREFETCH_NEXT_LINE;
+    else if (name == "stride") kind = PREFETCH_STRIDE;
+    else return false;
+    return true;
+}
+
+const char* prefetcherName(PrefetcherKind kind) {
+    switch (kind) {
+        case PREFETCH_NEXT_LINE: return "Next-line";
+        case PREFETCH_STRIDE:    return "Stride";
+        default:                 return "None";
+    }
+}
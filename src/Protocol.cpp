@@ -0,0 +1,21 @@
+#include "Protocol.hh"
+#include <algorithm>
+#include <cctype>
+
+const char* protocolName(ProtocolKind kind) {
+    switch (kind) {
+        case PROTOCOL_MOESI: return "MOESI";
+        case PROTOCOL_MESIF: return "MESIF";
+        default:             return "MESI";
+    }
+}
+
+bool parseProtocol(const std::string& name, ProtocolKind& kind) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    if (lower == "mesi") kind = PROTOCOL_MESI;
+    else if (lower == "moesi") kind = PROTOCOL_MOESI;
+    else if (lower == "mesif") kind = PROTOCOL_MESIF;
+    else return false;
+    return true;
+}
@@ -0,0 +1,212 @@
+#include "ResultCache.hh"
+#include "Simulator.hh"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <utime.h>
+#include <unistd.h>
+
+namespace {
+    const char* ENTRY_SUFFIX = ".result";
+    const uint64_t HASH_SEED = 0x9E3779B97F4A7C15ULL;
+    const uint64_t HASH_MUL = 0xFF51AFD7ED558CCDULL;
+    
+    // Mixes one 64-bit word into the running hash
+    inline uint64_t mix(uint64_t h, uint64_t word) {
+        h ^= word * HASH_SEED;
+        h = (h << 31) | (h >> 33);
+        return h * HASH_MUL;
+    }
+    
+    uint64_t hashBytes(uint64_t h, const char* data, size_t len) {
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            h = mix(h, word);
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, data + i, len - i);
+        return mix(h, tail ^ (static_cast<uint64_t>(len - i) << 56));
+    }
+    
+    std::string toHex(uint64_t value) {
+        std::ostringstream ss;
+        ss << std::hex << std::setw(16) << std::setfill('0') << value;
+        return ss.str();
+    }
+    
+    bool endsWith(const std::string& str, const std::string& suffix) {
+        return str.size() >= suffix.size() &&
+               str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+}
+
+ResultCache::ResultCache(const std::string& directory, uint64_t budgetBytes)
+    : hits(0), misses(0), stores(0), evictions(0), directory(directory), budgetBytes(budgetBytes) {
+    mkdir(directory.c_str(), 0755);
+    struct stat st;
+    usable = stat(directory.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    if (!usable)
+        std::cerr << "Warning: Result cache directory unavailable: " << directory << std::endl;
+    else
+        loadStats();
+}
+
+bool ResultCache::hashFile(const std::string& filename, uint64_t& hash) {
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return false;
+    
+    // Chunks are a multiple of 8 bytes, so only the final one has a partial word
+    std::vector<char> buffer(1 << 20);
+    uint64_t h = HASH_SEED;
+    uint64_t total = 0;
+    size_t n;
+    while ((n = fread(buffer.data(), 1, buffer.size(), f)) > 0) {
+        h = hashBytes(h, buffer.data(), n);
+        total += n;
+    }
+    fclose(f);
+    hash = mix(h, total);
+    return true;
+}
+
+std::string ResultCache::makeKey(const std::vector<std::string>& inputs, const std::string& config) const {
+    std::string material = std::string(SIMULATOR_VERSION) + "\n" + config + "\n";
+    for (const std::string& input : inputs) {
+        uint64_t hash;
+        if (!hashFile(input, hash))
+            return "";
+        material += toHex(hash) + "\n";
+    }
+    uint64_t key = hashBytes(HASH_SEED, material.data(), material.size());
+    uint64_t check = hashBytes(HASH_MUL, material.data(), material.size());
+    return toHex(key) + toHex(check);
+}
+
+std::string ResultCache::entryPath(const std::string& key) const {
+    return directory + "/" + key + ENTRY_SUFFIX;
+}
+
+bool ResultCache::lookup(const std::string& key, std::string& text) {
+    if (!usable || key.empty())
+        return false;
+    
+    std::ifstream fin(entryPath(key), std::ios::binary);
+    if (!fin.is_open()) {
+        misses++;
+        saveStats();
+        return false;
+    }
+    std::ostringstream contents;
+    contents << fin.rdbuf();
+    text = contents.str();
+    
+    // Refresh the modification time: eviction is least recently used first
+    utime(entryPath(key).c_str(), nullptr);
+    hits++;
+    saveStats();
+    return true;
+}
+
+void ResultCache::store(const std::string& key, const std::string& text) {
+    if (!usable || key.empty())
+        return;
+    
+    // Write then rename so concurrent sweeps never read a partial entry
+    std::string tmp = entryPath(key) + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream fout(tmp, std::ios::binary);
+        fout << text;
+        if (!fout.good()) {
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), entryPath(key).c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return;
+    }
+    stores++;
+    
+    uint64_t entries, bytes;
+    evict(entries, bytes);
+    saveStats();
+}
+
+void ResultCache::evict(uint64_t& entries, uint64_t& bytes) {
+    std::vector<std::pair<time_t, std::pair<std::string, uint64_t> > > files;
+    entries = 0;
+    bytes = 0;
+    
+    DIR* dir = opendir(directory.c_str());
+    if (!dir)
+        return;
+    while (struct dirent* ent = readdir(dir)) {
+        std::string name = ent->d_name;
+        if (!endsWith(name, ENTRY_SUFFIX))
+            continue;
+        std::string path = directory + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            continue;
+        files.push_back(std::make_pair(st.st_mtime, std::make_pair(path, static_cast<uint64_t>(st.st_size))));
+        bytes += st.st_size;
+    }
+    closedir(dir);
+    
+    std::sort(files.begin(), files.end());
+    size_t next = 0;
+    while (bytes > budgetBytes && next < files.size()) {
+        if (std::remove(files[next].second.first.c_str()) == 0) {
+            bytes -= files[next].second.second;
+            evictions++;
+        }
+        next++;
+    }
+    entries = files.size() - next;
+}
+
+void ResultCache::loadStats() {
+    std::ifstream fin(directory + "/stats");
+    std::string name;
+    uint64_t value;
+    while (fin >> name >> value) {
+        if (name == "hits") hits = value;
+        else if (name == "misses") misses = value;
+        else if (name == "stores") stores = value;
+        else if (name == "evictions") evictions = value;
+    }
+}
+
+void ResultCache::saveStats() const {
+    std::string path = directory + "/stats";
+    std::string tmp = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream fout(tmp);
+        fout << "hits " << hits << "\n"
+             << "misses " << misses << "\n"
+             << "stores " << stores << "\n"
+             << "evictions " << evictions << "\n";
+    }
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+void ResultCache::printStats(std::ostream& out, bool hit) {
+    if (!usable)
+        return;
+    uint64_t entries, bytes;
+    evict(entries, bytes);
+    out << "Result cache " << (hit ? "hit" : "miss") << " (" << directory << "): "
+        << hits << " hits, " << misses << " misses, " << stores << " stores, "
+        << evictions << " evictions, " << entries << " entries, "
+        << bytes / 1024 << " of " << budgetBytes / 1024 << " KB" << std::endl;
+}
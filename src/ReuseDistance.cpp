@@ -0,0 +1,110 @@
+#include "ReuseDistance.hh"
+#include <algorithm>
+#include <iomanip>
+#include <utility>
+
+namespace {
+    const uint32_t INITIAL_SLOTS = 1 << 16;
+    
+    // Bucket 0 holds distance 0, bucket k holds [2^(k-1), 2^k - 1]
+    size_t bucketOf(uint64_t distance) {
+        size_t bucket = 0;
+        while (distance > 0) {
+            distance >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+}
+
+ReuseDistance::ReuseDistance(int b)
+    : b(b), coldAccesses(0), totalAccesses(0), tree(INITIAL_SLOTS + 1, 0), now(0) {}
+
+void ReuseDistance::add(uint32_t slot, int32_t delta) {
+    for (size_t i = slot + 1; i < tree.size(); i += i & (~i + 1))
+        tree[i] += delta;
+}
+
+uint32_t ReuseDistance::prefix(uint32_t slot) const {
+    uint32_t sum = 0;
+    for (size_t i = slot + 1; i > 0; i -= i & (~i + 1))
+        sum += tree[i];
+    return sum;
+}
+
+void ReuseDistance::compact() {
+    // Renumber live blocks 0..n-1 in last-access order; grow so that at least
+    // half of the time axis is free after compaction
+    std::vector<std::pair<uint32_t, uint32_t> > live;
+    live.reserve(lastAccess.size());
+    for (const auto& entry : lastAccess)
+        live.push_back(std::make_pair(entry.second, entry.first));
+    std::sort(live.begin(), live.end());
+    
+    size_t slots = tree.size() - 1;
+    while (slots < 2 * live.size())
+        slots *= 2;
+    tree.assign(slots + 1, 0);
+    
+    for (uint32_t i = 0; i < live.size(); i++) {
+        lastAccess[live[i].second] = i;
+        tree[i + 1] = 1;
+    }
+    // Linear-time Fenwick build from the ones written above
+    for (size_t i = 1; i < tree.size(); i++) {
+        size_t parent = i + (i & (~i + 1));
+        if (parent < tree.size())
+            tree[parent] += tree[i];
+    }
+    now = static_cast<uint32_t>(live.size());
+}
+
+void ReuseDistance::access(uint32_t address) {
+    if (now + 1 >= tree.size())
+        compact();
+    
+    uint32_t block = address >> b;
+    totalAccesses++;
+    
+    auto it = lastAccess.find(block);
+    if (it == lastAccess.end()) {
+        coldAccesses++;
+        lastAccess.emplace(block, now);
+    } else {
+        // Every live mark after the previous access is a distinct block touched since
+        uint64_t distance = lastAccess.size() - prefix(it->second);
+        size_t bucket = bucketOf(distance);
+        if (histogram.size() <= bucket)
+            histogram.resize(bucket + 1, 0);
+        histogram[bucket]++;
+        
+        add(it->second, -1);
+        it->second = now;
+    }
+    add(now, 1);
+    now++;
+}
+
+void ReuseDistance::merge(const ReuseDistance& other) {
+    if (histogram.size() < other.histogram.size())
+        histogram.resize(other.histogram.size(), 0);
+    for (size_t i = 0; i < other.histogram.size(); i++)
+        histogram[i] += other.histogram[i];
+    coldAccesses += other.coldAccesses;
+    totalAccesses += other.totalAccesses;
+}
+
+void ReuseDistance::print(std::ostream& out, const std::string& label) const {
+    out << label << " Reuse Distance Histogram (" << totalAccesses << " accesses):" << std::endl;
+    for (size_t i = 0; i < histogram.size(); i++) {
+        if (histogram[i] == 0) continue;
+        uint64_t lo = (i == 0) ? 0 : (1ULL << (i - 1));
+        uint64_t hi = (i == 0) ? 0 : (1ULL << i) - 1;
+        double pct = (double)histogram[i] * 100.0 / totalAccesses;
+        out << "  [" << lo << ", " << hi << "]: " << histogram[i]
+            << " (" << std::fixed << std::setprecision(2) << pct << "%)" << std::endl;
+    }
+    double coldPct = totalAccesses ? (double)coldAccesses * 100.0 / totalAccesses : 0.0;
+    out << "  cold: " << coldAccesses
+        << " (" << std::fixed << std::setprecision(2) << coldPct << "%)" << std::endl;
+}
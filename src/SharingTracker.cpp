@@ -0,0 +1,130 @@
+#include "SharingTracker.hh"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+SharingTracker::SharingTracker(int b)
+    : trueSharing(0), falseSharing(0), b(b), chunkShift(b > 6 ? b - 6 : 0) {}
+
+uint64_t SharingTracker::offsetBit(uint32_t address) const {
+    uint32_t offset = address & ((1u << b) - 1);
+    return 1ULL << (offset >> chunkShift);
+}
+
+SharingTracker::BlockSharing& SharingTracker::share(std::unordered_map<uint32_t, SoleOwner>::iterator it) {
+    BlockSharing fresh;
+    std::memset(&fresh, 0, sizeof(fresh));
+    fresh.readMask[it->second.core] = it->second.readMask;
+    fresh.writeMask[it->second.core] = it->second.writeMask;
+    BlockSharing& block = blocks.emplace(it->first, fresh).first->second;
+    owned.erase(it);
+    return block;
+}
+
+void SharingTracker::access(int coreId, uint32_t address, bool isWrite) {
+    uint64_t bit = offsetBit(address);
+    auto it = blocks.find(address >> b);
+    if (it != blocks.end()) {
+        (isWrite ? it->second.writeMask : it->second.readMask)[coreId] |= bit;
+        return;
+    }
+    
+    auto sole = owned.find(address >> b);
+    if (sole == owned.end()) {
+        SoleOwner fresh = { 0, 0, coreId };
+        sole = owned.emplace(address >> b, fresh).first;
+    }
+    if (sole->second.core == coreId) {
+        (isWrite ? sole->second.writeMask : sole->second.readMask) |= bit;
+        return;
+    }
+    BlockSharing& block = share(sole);
+    (isWrite ? block.writeMask : block.readMask)[coreId] |= bit;
+}
+
+void SharingTracker::coherenceEvent(int requesterId, uint32_t address, bool isWrite, unsigned holderMask) {
+    if (holderMask == 0)
+        return;
+    BlockSharing* shared;
+    auto it = blocks.find(address >> b);
+    if (it != blocks.end()) {
+        shared = &it->second;
+    } else {
+        auto sole = owned.find(address >> b);
+        if (sole == owned.end())
+            return;
+        // The owner's own event only starts a new epoch; anyone else is a second core
+        if (sole->second.core == requesterId) {
+            sole->second.readMask = 0;
+            sole->second.writeMask = 0;
+            return;
+        }
+        shared = &share(sole);
+    }
+    BlockSharing& block = *shared;
+    
+    // Reads only communicate with data the holders wrote; writes also
+    // conflict with data the holders read
+    uint64_t bit = offsetBit(address);
+    uint64_t used = 0;
+    uint64_t written = 0;
+    for (int core = 0; core < MAX_CORES; core++) {
+        if (!(holderMask & (1u << core)) || core == requesterId) continue;
+        written |= block.writeMask[core];
+        used |= block.writeMask[core] | block.readMask[core];
+    }
+    uint64_t conflicting = isWrite ? used : written;
+    
+    if (conflicting & bit) {
+        block.trueEvents++;
+        trueSharing++;
+    } else if (conflicting != 0) {
+        block.falseEvents++;
+        falseSharing++;
+        block.falseOffsets |= conflicting | bit;
+    }
+    // Read sharing of clean data is neither true nor false sharing
+    
+    // Start a new epoch for this block
+    std::memset(block.readMask, 0, sizeof(block.readMask));
+    std::memset(block.writeMask, 0, sizeof(block.writeMask));
+}
+
+void SharingTracker::printOffsets(std::ostream& out, uint64_t mask) const {
+    // Print runs of set bits as byte ranges
+    int chunk = 1 << chunkShift;
+    for (int i = 0; i < 64; i++) {
+        if (!(mask & (1ULL << i))) continue;
+        int j = i;
+        while (j + 1 < 64 && (mask & (1ULL << (j + 1)))) j++;
+        out << " [" << i * chunk << "-" << (j + 1) * chunk - 1 << "]";
+        i = j;
+    }
+}
+
+void SharingTracker::print(std::ostream& out, size_t top) const {
+    out << "Sharing Analysis:" << std::endl;
+    out << "True Sharing Events: " << trueSharing << std::endl;
+    out << "False Sharing Events: " << falseSharing << std::endl;
+    
+    std::vector<std::pair<uint32_t, uint32_t> > worst;   // (false events, block)
+    for (const auto& entry : blocks) {
+        if (entry.second.falseEvents > 0)
+            worst.push_back(std::make_pair(entry.second.falseEvents, entry.first));
+    }
+    size_t shown = std::min(top, worst.size());
+    std::partial_sort(worst.begin(), worst.begin() + shown, worst.end(),
+                      [](const std::pair<uint32_t, uint32_t>& x, const std::pair<uint32_t, uint32_t>& y) {
+                          return x.first > y.first || (x.first == y.first && x.second < y.second);
+                      });
+    
+    if (shown > 0)
+        out << "Worst False-Sharing Blocks:" << std::endl;
+    for (size_t i = 0; i < shown; i++) {
+        const BlockSharing& block = blocks.at(worst[i].second);
+        out << "  0x" << std::hex << (static_cast<uint64_t>(worst[i].second) << b) << std::dec
+            << ": " << block.falseEvents << " false, " << block.trueEvents << " true, offsets";
+        printOffsets(out, block.falseOffsets);
+        out << std::endl;
+    }
+}
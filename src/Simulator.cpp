@@ -1,17 +1,26 @@
 #include "Simulator.hh"
 #include "Cache.hh"
+#include "Protocol.hh"
 #include <iostream>
 #include <fstream>
 #include <climits>
 #include <cstdlib>
 #include <iomanip>  // Add this for setprecision and fixed#include <iomanip>
+#include <algorithm>
+#include <cstdint>
 
-Simulator::Simulator(int s, int E, int b)
-    : s(s), E(E), b(b), globalCycle(0)
+namespace {
+    // Indexed by CacheState
+    const char STATE_LETTERS[NUM_CACHE_STATES] = { 'M', 'E', 'S', 'I', 'O', 'F' };
+}
+
+Simulator::Simulator(int s, int E, int b, ProtocolKind protocol)
+    : s(s), E(E), b(b), protocol(protocol), globalCycle(0), reuseAnalysis(false), eventLog(nullptr), sharing(nullptr),
+      l2(nullptr), prefetching(false)
 {
     // Create 4 cores.
     for (int i = 0; i < 4; i++) {
-        Cache* cache = new Cache(s, E, b);
+        Cache* cache = new Cache(s, E, b, protocol);
         Core* core = new Core(i, cache);
         cores.push_back(core);
     }
@@ -19,8 +28,89 @@ Simulator::Simulator(int s, int E, int b)
 
 Simulator::~Simulator() {
     for (Core* core : cores) {
-        delete core->cache;
+        // Deleting the core joins its trace decoder, which may still be feeding
+        // the reuse analyzer, so the core goes first
+        Cache* cache = core->cache;
+        ReuseDistance* reuse = core->reuse;
         delete core;
+        delete reuse;
+        delete cache;
+    }
+    delete eventLog;
+    delete sharing;
+    delete l2;
+}
+
+void Simulator::enableSharingAnalysis() {
+    if (!sharing)
+        sharing = new SharingTracker(b);
+    bus.sharing = sharing;
+}
+
+void Simulator::enablePrefetcher(PrefetcherKind kind, int degree, int distance) {
+    if (kind == PREFETCH_NONE)
+        return;
+    prefetching = true;
+    for (Core* core : cores) {
+        delete core->cache->prefetcher;
+        core->cache->prefetcher = new Prefetcher(kind, b, degree, distance);
+    }
+}
+
+bool Simulator::enableL2(int s2, int E2, int b2, uint64_t hitLatency, L2Replacement replacement) {
+    if (b2 < b)
+        return false;
+    delete l2;
+    l2 = new L2Cache(s2, E2, b2, hitLatency, replacement);
+    bus.l2 = l2;
+    return true;
+}
+
+void Simulator::enableNonBlocking(int mshrCount) {
+    for (Core* core : cores)
+        core->cache->mshrs.assign(mshrCount > 0 ? mshrCount : 0, MshrEntry());
+}
+
+void Simulator::issue(Core* core, uint64_t cycle) {
+    Request req = *core->currentRequest();
+    size_t before = core->instPtr;
+    core->cache->accessCache(req.isWrite, req.address, cycle, core->id, bus, cores);
+    if (sharing && core->instPtr != before)
+        sharing->access(core->id, req.address, req.isWrite);
+}
+
+void Simulator::grant(const Bus::Waiter& waiter) {
+    if (waiter.mshr < 0)
+        issue(cores[waiter.coreId], globalCycle);
+    else
+        cores[waiter.coreId]->cache->issueMshr(waiter.mshr, globalCycle, waiter.coreId, bus, cores);
+}
+
+void Simulator::setArbitration(Arbitration arbitration) {
+    bus.arbitration = arbitration;
+}
+
+bool Simulator::enableEventLog(const std::string& filename) {
+    EventLog* log = new EventLog();
+    if (!log->open(filename, b)) {
+        delete log;
+        return false;
+    }
+    delete eventLog;
+    eventLog = log;
+    bus.eventLog = eventLog;
+    return true;
+}
+
+bool Simulator::closeEventLog() {
+    return eventLog == nullptr || eventLog->close();
+}
+
+void Simulator::enableReuseAnalysis() {
+    reuseAnalysis = true;
+    for (Core* core : cores) {
+        if (!core->reuse)
+            core->reuse = new ReuseDistance(b);
     }
 }
 
@@ -31,65 +121,140 @@ void Simulator::loadTraces(const std::string& baseName) {
     }
 }
 
-// (partial implementation - just the run method)
-void Simulator::run() {
-    uint64_t globalCycle = 0;
+void Simulator::streamTraces(const std::string& baseName) {
+    for (int i = 0; i < 4; i++) {
+        std::string filename = baseName + "_proc" + std::to_string(i) + ".trace";
+        cores[i]->streamTrace(filename);
+    }
+}
+
+void Simulator::pushAccess(int coreId, bool isWrite, uint32_t address) {
+    cores[coreId]->pushRequest(Request(isWrite, address));
+}
+
+bool Simulator::step() {
     bool pending = false;
 
-    while (true) {
-        pending = false;
-        // 
-        if (bus.isbusy && bus.freeCycle + 1 <= globalCycle ) {
-            if(bus.moreleft){
-                Core* core = cores[bus.coreid]; 
-                Request& req = core->trace[core->instPtr];    
-                // Access the cache
-                // Update the core's instruction pointer and next free cycle in the cache
-                bus.isbusy = false;     // Reset bus status
-                bus.moreleft = false;   // More left to process the block 
-                core->cache->accessCache(req.isWrite, req.address, globalCycle, core->id, bus, cores); 
-            }
-            else
-                cores[bus.coreid]->cache->busupdate(bus);
+    // 
+    if (bus.isbusy && bus.freeCycle + 1 <= globalCycle ) {
+        if(bus.moreleft){
+            Core* core = cores[bus.coreid]; 
+            // Access the cache
+            // Update the core's instruction pointer and next free cycle in the cache
+            bus.isbusy = false;     // Reset bus status
+            bus.moreleft = false;   // More left to process the block 
+            issue(core, globalCycle);
         }
-        // Process each core for the current cycle
-        for (Core* core : cores) {
-            // Skip if core is waiting for a previous request
-            if (core->nextFreeCycle >= globalCycle){
-                pending = true;
-                continue;
-            }
+        else
+            cores[bus.coreid]->cache->busupdate(bus);
+    }
+    // FIFO arbitration hands a free bus to waiters in the order they asked for it.
+    // A grant that does not occupy the bus (e.g. an upgrade) lets the next waiter in.
+    while (bus.arbitration == ARBITRATION_FIFO && !bus.isbusy && bus.hasWaiters())
+        grant(bus.grantBus(globalCycle, cores));
+    // Process each core for the current cycle
+    for (Core* core : cores) {
+        // Retry arbitration: a free bus goes to the first core in this loop that
+        // wants it, whether it was already waiting or has just become ready
+        bool granted = false;
+        while (bus.arbitration == ARBITRATION_RETRY && !bus.isbusy) {
+            Bus::Waiter waiter = bus.grantBus(globalCycle, cores, core->id);
+            if (waiter.coreId < 0)
+                break;
+            grant(waiter);
+            granted = granted || waiter.mshr < 0;
+        }
+        
+        // A parked core is not polled, but the baseline retries every cycle and
+        // goes ahead as soon as its access stops needing the bus
+        if (!granted && stoppedWaiting(core))
+            bus.unpark(core->id, globalCycle, cores);
+        
+        // Skip if core is waiting for a previous request or for the bus
+        if (granted || core->nextFreeCycle >= globalCycle || core->parked){
+            pending = true;
+            continue;
+        }
+        
+        // Check if core has more instructions to process
+        if (core->currentRequest() != nullptr) {
+            pending = true;
             
-            // Check if core has more instructions to process
-            if (core->instPtr < core->trace.size()) {
-                pending = true;
-                
-                // Get the current request
-                Request& req = core->trace[core->instPtr];
-                
-                // Access the cache
-                // Update the core's instruction pointer and next free cycle in the cache
-               core->cache->accessCache(req.isWrite, req.address, globalCycle, core->id, bus, cores); 
+            // Access the cache
+            // Update the core's instruction pointer and next free cycle in the cache
+            issue(core, globalCycle);
+        }
+    }
+    // Demand traffic goes first; a bus still idle after it carries one prefetch,
+    // with cores taking turns at going first. The turn follows the cycle number,
+    // not the number of steps, so skipping idle cycles cannot change it.
+    if (prefetching && !bus.isbusy && !bus.hasWaiters()) {
+        for (size_t n = 0; n < cores.size() && !bus.isbusy; n++) {
+            Core* core = cores[(globalCycle + n) % cores.size()];
+            core->cache->issuePrefetch(globalCycle, core->id, bus, cores);
+        }
+    }
+    // Misses queued by non-blocking caches still need the bus
+    if (bus.hasWaiters())
+        pending = true;
+    // Review this part
+    // If no more instructions and no pending operations, we're done
+    if (!pending) {
+        bool allDone = true;
+        for (Core* core : cores) {
+            if (core->currentRequest() != nullptr || core->nextFreeCycle > globalCycle) {
+                allDone = false;
+                break;
             }
         }
-        // Review this part
-        // If no more instructions and no pending operations, we're done
-        if (!pending) {
-            bool allDone = true;
+        if (allDone) {
+            // A non-blocking core is only done once its last fill has arrived;
+            // it resumes from there if more accesses are pushed
             for (Core* core : cores) {
-                if (core->instPtr < core->trace.size() || core->nextFreeCycle > globalCycle) {
-                    allDone = false;
-                    break;
+                if (!core->cache->mshrs.empty()) {
+                    uint64_t wait = core->cache->drainMshrs(core->nextFreeCycle);
+                    core->execycles += wait;
+                    core->nextFreeCycle += wait;
                 }
             }
-            if (allDone) break;
-        } else {
-            // Move to next cycle
-            globalCycle++;
+            return false;
+        }
+    } else {
+        // Nothing can happen until the bus frees up or a running core unblocks,
+        // so jump straight to that cycle instead of ticking through the stall
+        uint64_t nextCycle = UINT64_MAX;
+        if (bus.isbusy)
+            nextCycle = bus.freeCycle + 1;
+        else if (prefetching) {
+            for (Core* core : cores) {
+                if (!core->cache->prefetcher->queue.empty())
+                    nextCycle = globalCycle + 1;
+            }
         }
+        for (Core* core : cores) {
+            // A finished core only matters while it is still stalled on its last access
+            bool waking = core->currentRequest() != nullptr || core->nextFreeCycle >= globalCycle;
+            if (!core->parked && waking)
+                nextCycle = std::min(nextCycle, std::max(core->nextFreeCycle + 1, globalCycle + 1));
+            else if (stoppedWaiting(core))
+                nextCycle = globalCycle + 1;
+        }
+        globalCycle = (nextCycle == UINT64_MAX) ? globalCycle + 1 : nextCycle;
     }
+    return true;
 }
 
+bool Simulator::stoppedWaiting(Core* core) {
+    if (!core->parked)
+        return false;
+    const Request* req = core->currentRequest();
+    return !core->cache->needsBus(req->isWrite, req->address);
+}
+
+void Simulator::run() {
+    while (step()) {
+    }
+}
 
 void Simulator::printResults(const std::string& outFilename, const std::string& trace_prefix) {
     std::ostream *out;
@@ -107,6 +272,15 @@ void Simulator::printResults(const std::string& outFilename, const std::string&
     else
         out = &std::cout;
     
+    printResults(*out, trace_prefix);
+
+    if (ofs.is_open())
+        ofs.close();
+}
+
+void Simulator::printResults(std::ostream& os, const std::string& trace_prefix) {
+    std::ostream *out = &os;
+    
     // Calculate cache size in KB
     double cacheSizeKB = (1 << s) * E * (1 << b) / 1024.0;
     
@@ -119,10 +293,24 @@ void Simulator::printResults(const std::string& outFilename, const std::string&
     *out << "Block Size (Bytes): " << (1 << b) << std::endl;
     *out << "Number of Sets: " << (1 << s) << std::endl;
     *out << "Cache Size (KB per core): " << cacheSizeKB << std::endl;
-    *out << "MESI Protocol: Enabled" << std::endl;
+    *out << protocolName(protocol) << " Protocol: Enabled" << std::endl;
     *out << "Write Policy: Write-back, Write-allocate" << std::endl;
     *out << "Replacement Policy: LRU" << std::endl;
     *out << "Bus: Central snooping bus" << std::endl;
+    if (bus.arbitration != ARBITRATION_RETRY)
+        *out << "Bus Arbitration: " << arbitrationName(bus.arbitration) << std::endl;
+    if (l2) {
+        *out << "L2: Shared inclusive, " << (1 << l2->s) * l2->E * (1 << l2->b) / 1024.0 << " KB, "
+             << l2->E << "-way, " << (1 << l2->b) << "-byte blocks, " << l2->hitLatency
+             << "-cycle hits, " << l2ReplacementName(l2->replacement) << " replacement" << std::endl;
+    }
+    if (!cores[0]->cache->mshrs.empty())
+        *out << "Non-blocking L1: " << cores[0]->cache->mshrs.size() << " MSHRs per core" << std::endl;
+    if (prefetching) {
+        const Prefetcher* p = cores[0]->cache->prefetcher;
+        *out << "Prefetcher: " << prefetcherName(p->kind) << " (degree " << p->degree
+             << ", distance " << p->distance << ")" << std::endl;
+    }
     *out << std::endl;
 
     // Print per-core statistics
@@ -137,17 +325,60 @@ void Simulator::printResults(const std::string& outFilename, const std::string&
         // int evictions = totalMisses - core->cache->writeBacks;
         
         *out << "Core " << core->id << " Statistics:" << std::endl;
-        *out << "Total Instructions: " << core->trace.size() << std::endl;
+        *out << "Total Instructions: " << core->readCount + core->writeCount << std::endl;
         *out << "Total Reads: " << core->readCount << std::endl;
         *out << "Total Writes: " << core->writeCount << std::endl;
         *out << "Total Execution Cycles: " << core->execycles << std::endl;
         *out << "Idle Cycles: " << core->cache->idleCycles << std::endl;
         *out << "Cache Misses: " << totalMisses << std::endl;
         *out << "Cache Miss Rate: " << std::fixed << std::setprecision(2) << missRate << "%" << std::endl;
+        *out << "Compulsory Misses: " << core->cache->compulsoryMisses << std::endl;
+        *out << "Capacity Misses: " << core->cache->capacityMisses << std::endl;
+        *out << "Conflict Misses: " << core->cache->conflictMisses << std::endl;
+        *out << "Coherence Misses: " << core->cache->coherenceMisses << std::endl;
+        if (l2)
+            *out << "Inclusion Misses: " << core->cache->inclusionMisses << std::endl;
         *out << "Cache Evictions: " << core->cache->evictions << std::endl;
         *out << "Writebacks: " << core->cache->writeBacks << std::endl;
         *out << "Bus Invalidations: " << core->cache->invalidations << std::endl;
         *out << "Data Traffic (Bytes): " << core->cache->trafficBytes << std::endl;
+        if (l2)
+            *out << "Back-Invalidations: " << core->cache->backInvalidations << std::endl;
+        *out << "State Transitions:";
+        for (int from = 0; from < NUM_CACHE_STATES; from++) {
+            for (int to = 0; to < NUM_CACHE_STATES; to++) {
+                if (core->cache->transitions[from][to] > 0)
+                    *out << " " << STATE_LETTERS[from] << "->" << STATE_LETTERS[to]
+                         << "=" << core->cache->transitions[from][to];
+            }
+        }
+        *out << std::endl;
+        if (!core->cache->mshrs.empty()) {
+            const Cache* cache = core->cache;
+            uint64_t elapsed = core->execycles + cache->idleCycles;
+            double occupancy = elapsed ? (double)cache->mshrBusyCycles / elapsed : 0.0;
+            *out << "MSHR Allocations: " << cache->mshrAllocations << std::endl;
+            *out << "MSHR Merges: " << cache->mshrMerges << std::endl;
+            *out << "Peak MSHR Occupancy: " << cache->mshrPeak << std::endl;
+            *out << "Average MSHR Occupancy: " << occupancy << std::endl;
+            *out << "MSHR Full Stall Cycles: " << cache->mshrFullStalls << std::endl;
+        }
+        if (prefetching) {
+            const Prefetcher* p = core->cache->prefetcher;
+            double accuracy = p->issued ? p->useful * 100.0 / p->issued : 0.0;
+            double coverage = (p->useful + totalMisses) ? p->useful * 100.0 / (p->useful + totalMisses) : 0.0;
+            double timeliness = p->useful ? (p->useful - p->late) * 100.0 / p->useful : 0.0;
+            *out << "Prefetches Issued: " << p->issued << std::endl;
+            *out << "Useful Prefetches: " << p->useful << std::endl;
+            *out << "Late Prefetches: " << p->late << std::endl;
+            *out << "Useless Prefetches: " << p->useless << std::endl;
+            *out << "Dropped Prefetches: " << p->dropped << std::endl;
+            *out << "Prefetch Accuracy: " << accuracy << "%" << std::endl;
+            *out << "Prefetch Coverage: " << coverage << "%" << std::endl;
+            *out << "Prefetch Timeliness: " << timeliness << "%" << std::endl;
+            *out << "Prefetch Traffic (Bytes): " << p->trafficBytes << std::endl;
+            *out << "Demand Cycles Delayed by Prefetches: " << core->cache->prefetchDelayCycles << std::endl;
+        }
         *out << std::endl;
     }
     
@@ -156,6 +387,33 @@ void Simulator::printResults(const std::string& outFilename, const std::string&
     *out << "Total Bus Transactions: " << bus.busTransactions << std::endl;
     *out << "Total Bus Traffic (Bytes): " << bus.trafficBytes << std::endl;
 
-    if (ofs.is_open())
-        ofs.close();
+    if (l2) {
+        uint64_t accesses = l2->hits + l2->misses;
+        *out << std::endl;
+        *out << "L2 Statistics:" << std::endl;
+        *out << "L2 Accesses: " << accesses << std::endl;
+        *out << "L2 Hits: " << l2->hits << std::endl;
+        *out << "L2 Misses: " << l2->misses << std::endl;
+        *out << "L2 Miss Rate: " << (accesses ? l2->misses * 100.0 / accesses : 0.0) << "%" << std::endl;
+        *out << "L2 Writebacks: " << l2->writebacks << std::endl;
+        *out << "L2 Back-Invalidations: " << l2->backInvalidations << std::endl;
+        *out << "Snoops Filtered: " << l2->snoopsFiltered << std::endl;
+        if (l2->inclusionViolations > 0)
+            *out << "L2 Inclusion Violations: " << l2->inclusionViolations << std::endl;
+    }
+
+    if (reuseAnalysis) {
+        ReuseDistance combined(b);
+        *out << std::endl;
+        for (Core* core : cores) {
+            core->reuse->print(*out, "Core " + std::to_string(core->id));
+            combined.merge(*core->reuse);
+        }
+        combined.print(*out, "All Cores");
+    }
+
+    if (sharing) {
+        *out << std::endl;
+        sharing->print(*out);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "TagMatch.hh"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HERMES_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+int tagMatchScalar(const uint32_t* tags, int ways, uint32_t tag) {
+    for (int i = 0; i < ways; i++) {
+        if (tags[i] == tag)
+            return i;
+    }
+    return -1;
+}
+
+#ifdef HERMES_X86_KERNELS
+__attribute__((target("sse2")))
+int tagMatchSse2(const uint32_t* tags, int ways, uint32_t tag) {
+    __m128i key = _mm_set1_epi32(static_cast<int>(tag));
+    for (int i = 0; i < ways; i += 4) {
+        __m128i row = _mm_load_si128(reinterpret_cast<const __m128i*>(tags + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(row, key)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return -1;
+}
+
+__attribute__((target("avx2")))
+int tagMatchAvx2(const uint32_t* tags, int ways, uint32_t tag) {
+    __m256i key = _mm256_set1_epi32(static_cast<int>(tag));
+    for (int i = 0; i < ways; i += 8) {
+        __m256i row = _mm256_load_si256(reinterpret_cast<const __m256i*>(tags + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(row, key)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return -1;
+}
+#endif
+
+} // namespace
+
+TagMatchFn tagMatchKernel(TagMatchKernel kernel) {
+    switch (kernel) {
+#ifdef HERMES_X86_KERNELS
+        case TAG_MATCH_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? tagMatchAvx2 : nullptr;
+        case TAG_MATCH_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2") ? tagMatchSse2 : nullptr;
+#endif
+        case TAG_MATCH_SCALAR:
+            return tagMatchScalar;
+        default:
+            return nullptr;
+    }
+}
+
+TagMatchFn selectTagMatch(int associativity) {
+    if (associativity < 4)
+        return tagMatchScalar;
+    if (TagMatchFn avx2 = tagMatchKernel(TAG_MATCH_AVX2))
+        return avx2;
+    if (TagMatchFn sse2 = tagMatchKernel(TAG_MATCH_SSE2))
+        return sse2;
+    return tagMatchScalar;
+}
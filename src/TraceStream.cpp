@@ -0,0 +1,58 @@
+#include "TraceStream.hh"
+#include <fstream>
+#include <iostream>
+
+TraceStream::TraceStream(const std::string& filename, ReuseDistance* reuse, size_t depth)
+    : filename(filename), reuse(reuse), queue(depth), finished(false), stopping(false),
+      decoder(&TraceStream::decode, this) {}
+
+TraceStream::~TraceStream() {
+    stopping.store(true, std::memory_order_relaxed);
+    if (decoder.joinable())
+        decoder.join();
+}
+
+void TraceStream::decode() {
+    std::ifstream fin(filename);
+    if (!fin.is_open()) {
+        std::cerr << "Warning: Could not open trace file: " << filename << std::endl;
+        finished.store(true, std::memory_order_release);
+        return;
+    }
+    
+    std::string line;
+    Request req;
+    bool any = false;
+    while (getline(fin, line)) {
+        // The consumer may give up at any point, not only while the ring is full
+        if (stopping.load(std::memory_order_relaxed))
+            return;
+        if (!parseTraceLine(line, filename, req))
+            continue;
+        if (reuse)
+            reuse->access(req.address);
+        any = true;
+        
+        // Backpressure: wait for the simulation thread to drain the ring
+        while (!queue.push(req)) {
+            if (stopping.load(std::memory_order_relaxed))
+                return;
+            std::this_thread::yield();
+        }
+    }
+    
+    if (!any) {
+        std::cerr << "Warning: No valid operations loaded from trace file: " << filename << std::endl;
+    }
+    finished.store(true, std::memory_order_release);
+}
+
+bool TraceStream::next(Request& out) {
+    while (!queue.pop(out)) {
+        // Items pushed before finished was set are visible after this acquire
+        if (finished.load(std::memory_order_acquire))
+            return queue.pop(out);
+        std::this_thread::yield();
+    }
+    return true;
+}
@@ -1,11 +1,45 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <cstdlib>
+#include <cstdio>
 #include <string>
+#include <vector>
 #include "Simulator.hh"
+#include "ResultCache.hh"
+#include "Protocol.hh"
+#include "Prefetcher.hh"
 
 void printHelp(char* programName) {
     std::cout << "Usage: " << programName
-              << " -t <tracefileBase> -s <s> -E <E> -b <b> -o <outfilename>\n";
+              << " -t <tracefileBase> -s <s> -E <E> -b <b> -o <outfilename> [-p <protocol>] [-A <arbitration>] [-P <prefetcher> [-D <degree>] [-d <distance>]] [-M <mshrs>] [-L <s>,<E>,<b> [-H <cycles>] [-R <policy>]] [-r] [-f] [-l <logfile>] [-c <cachedir> [-m <MB>]]\n"
+              << "  -p  Coherence protocol: mesi (default), moesi or mesif\n"
+              << "  -A  Bus arbitration: retry (default, lowest core first) or fifo (oldest request first)\n"
+              << "  -P  L1 prefetcher: none (default), nextline or stride\n"
+              << "  -D  Blocks proposed per prefetch trigger, at least 1 (default 1)\n"
+              << "  -d  Prefetch distance in blocks, at least 1 (default 1)\n"
+              << "  -M  Make the L1s non-blocking with this many MSHRs each (default 0: blocking)\n"
+              << "  -L  Add a shared inclusive L2 with these set bits, ways and block bits\n"
+              << "  -H  L2 hit latency in cycles (default 20)\n"
+              << "  -R  L2 replacement: lru (default) or random\n"
+              << "  -r  Report per-core reuse-distance histograms\n"
+              << "  -f  Report true/false sharing per block\n"
+              << "  -l  Write a binary coherence event log (read it with hermeslog)\n"
+              << "  -c  Reuse results stored in this directory for unchanged traces and options\n"
+              << "  -m  Size budget of the result cache in MB (default 256)\n";
+}
+
+// Writes finished results to outFilename, or to stdout if it is empty or cannot be opened
+void writeOutput(const std::string& text, const std::string& outFilename) {
+    if (!outFilename.empty()) {
+        std::ofstream ofs(outFilename);
+        if (ofs.is_open()) {
+            ofs << text;
+            return;
+        }
+        std::cerr << "Error opening output file: " << outFilename << std::endl;
+    }
+    std::cout << text;
 }
 
 int main(int argc, char* argv[]) {
@@ -15,6 +49,20 @@ int main(int argc, char* argv[]) {
     int b = 5;                // 2^5 = 32-byte block size
     std::string traceBaseName = "app1"; // e.g., app1_proc0.trace, etc.
     std::string outFilename = "";
+    ProtocolKind protocol = PROTOCOL_MESI;
+    Arbitration arbitration = ARBITRATION_RETRY;
+    PrefetcherKind prefetcher = PREFETCH_NONE;
+    int prefetchDegree = 1;
+    int prefetchDistance = 1;
+    int mshrCount = 0;
+    int l2s = -1, l2E = 0, l2b = 0;     // No L2 unless -L is given
+    uint64_t l2HitLatency = 20;
+    L2Replacement l2Replacement = L2_LRU;
+    bool reuseAnalysis = false;
+    bool sharingAnalysis = false;
+    std::string logFilename = "";
+    std::string cacheDir = "";
+    uint64_t cacheBudgetMB = 256;
 
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -29,16 +77,126 @@ int main(int argc, char* argv[]) {
             b = std::stoi(argv[++i]);
         } else if (arg == "-o" && i + 1 < argc) {
             outFilename = argv[++i];
+        } else if (arg == "-p" && i + 1 < argc) {
+            if (!parseProtocol(argv[++i], protocol)) {
+                std::cerr << "Unknown protocol: " << argv[i] << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        } else if (arg == "-A" && i + 1 < argc) {
+            if (!parseArbitration(argv[++i], arbitration)) {
+                std::cerr << "Unknown bus arbitration: " << argv[i] << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        } else if (arg == "-P" && i + 1 < argc) {
+            if (!parsePrefetcher(argv[++i], prefetcher)) {
+                std::cerr << "Unknown prefetcher: " << argv[i] << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        } else if (arg == "-D" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d", &prefetchDegree) != 1 || prefetchDegree < 1) {
+                std::cerr << "Invalid prefetch degree (expected at least 1): " << argv[i] << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        } else if (arg == "-d" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d", &prefetchDistance) != 1 || prefetchDistance < 1) {
+                std::cerr << "Invalid prefetch distance (expected at least 1): " << argv[i] << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        } else if (arg == "-M" && i + 1 < argc) {
+            mshrCount = std::stoi(argv[++i]);
+        } else if (arg == "-L" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d,%d", &l2s, &l2E, &l2b) != 3 || l2s < 0 || l2E < 1 || l2b < 0) {
+                std::cerr << "Invalid L2 geometry (expected s,E,b): " << argv[i] << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        } else if (arg == "-H" && i + 1 < argc) {
+            l2HitLatency = std::stoull(argv[++i]);
+        } else if (arg == "-R" && i + 1 < argc) {
+            if (!parseL2Replacement(argv[++i], l2Replacement)) {
+                std::cerr << "Unknown L2 replacement policy: " << argv[i] << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        } else if (arg == "-l" && i + 1 < argc) {
+            logFilename = argv[++i];
+        } else if (arg == "-c" && i + 1 < argc) {
+            cacheDir = argv[++i];
+        } else if (arg == "-m" && i + 1 < argc) {
+            cacheBudgetMB = std::stoull(argv[++i]);
+        } else if (arg == "-r") {
+            reuseAnalysis = true;
+        } else if (arg == "-f") {
+            sharingAnalysis = true;
         } else if (arg == "-h") {
             printHelp(argv[0]);
             exit(EXIT_SUCCESS);
         }
     }
 
-    Simulator sim(s, E, b);
-    sim.loadTraces(traceBaseName);
+    // A cached result is only valid for identical traces and options. The event
+    // log is a side effect of simulating, so runs that write one always simulate.
+    ResultCache* cache = nullptr;
+    std::string cacheKey;
+    if (!cacheDir.empty() && logFilename.empty()) {
+        cache = new ResultCache(cacheDir, cacheBudgetMB << 20);
+        std::vector<std::string> inputs;
+        for (int i = 0; i < 4; i++)
+            inputs.push_back(traceBaseName + "_proc" + std::to_string(i) + ".trace");
+        // Built from the parsed values in a fixed order, so the key does not depend
+        // on how the options were spelled or ordered. Every option that changes
+        // the printed results must appear here; unused settings are left out.
+        std::string config = "s=" + std::to_string(s) + " E=" + std::to_string(E) + " b=" + std::to_string(b) +
+                             " protocol=" + protocolName(protocol) +
+                             " arbitration=" + arbitrationName(arbitration) +
+                             " prefetch=" + prefetcherName(prefetcher);
+        if (prefetcher != PREFETCH_NONE)
+            config += " degree=" + std::to_string(prefetchDegree) + " distance=" + std::to_string(prefetchDistance);
+        config += " mshrs=" + std::to_string(mshrCount > 0 ? mshrCount : 0);
+        if (l2s >= 0) {
+            config += " l2=" + std::to_string(l2s) + "," + std::to_string(l2E) + "," + std::to_string(l2b) +
+                      " l2hit=" + std::to_string(l2HitLatency) + " l2repl=" + l2ReplacementName(l2Replacement);
+        }
+        config += std::string(" reuse=") + (reuseAnalysis ? "1" : "0") +
+                  " sharing=" + (sharingAnalysis ? "1" : "0") +
+                  " prefix=" + traceBaseName;
+        cacheKey = cache->makeKey(inputs, config);
+        
+        std::string text;
+        if (cache->lookup(cacheKey, text)) {
+            writeOutput(text, outFilename);
+            cache->printStats(std::cerr, true);
+            delete cache;
+            return 0;
+        }
+    }
+
+    Simulator sim(s, E, b, protocol);
+    sim.setArbitration(arbitration);
+    if (reuseAnalysis)
+        sim.enableReuseAnalysis();
+    if (sharingAnalysis)
+        sim.enableSharingAnalysis();
+    sim.enablePrefetcher(prefetcher, prefetchDegree, prefetchDistance);
+    sim.enableNonBlocking(mshrCount);
+    if (l2s >= 0 && !sim.enableL2(l2s, l2E, l2b, l2HitLatency, l2Replacement)) {
+        std::cerr << "L2 blocks must be at least as large as L1 blocks" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (!logFilename.empty() && !sim.enableEventLog(logFilename))
+        exit(EXIT_FAILURE);
+    sim.streamTraces(traceBaseName);
     sim.run();
-    sim.printResults(outFilename, traceBaseName);
+    // The results are still printed, but a run with an incomplete log fails
+    int status = sim.closeEventLog() ? 0 : EXIT_FAILURE;
+    if (cache) {
+        std::ostringstream results;
+        sim.printResults(results, traceBaseName);
+        writeOutput(results.str(), outFilename);
+        cache->store(cacheKey, results.str());
+        cache->printStats(std::cerr, false);
+        delete cache;
+    } else {
+        sim.printResults(outFilename, traceBaseName);
+    }
 
-    return 0;
+    return status;
 }
@@ -0,0 +1,40 @@
+#include "Simulator.hh"
+#include "Check.hh"
+#include <cstdint>
+
+namespace {
+    void testParkedUpgradePromoted() {
+        // Direct-mapped, two sets of 4-byte blocks. Core 2 reads 0x0 and parks its
+        // write upgrade behind the bus. Core 0 then evicts its own copy of 0x0, which
+        // leaves core 2 as the only sharer and promotes it to EXCLUSIVE, so the
+        // write goes ahead silently instead of waiting for the bus. The expected
+        // figures are those of the original per-cycle retry loop.
+        Simulator sim(1, 1, 2, PROTOCOL_MESI);
+        sim.pushAccess(0, true, 0x0);
+        sim.pushAccess(0, false, 0x8);
+        sim.pushAccess(1, true, 0x4);
+        sim.pushAccess(2, false, 0x0);
+        sim.pushAccess(2, true, 0x0);
+        sim.pushAccess(3, true, 0x10);
+        sim.run();
+
+        const uint64_t execCycles[] = { 202, 101, 4, 101 };
+        const uint64_t idleCycles[] = { 2, 0, 100, 204 };
+        for (int i = 0; i < 4; i++) {
+            Core* core = sim.getCores()[i];
+            CHECK_EQ(core->execycles, execCycles[i]);
+            CHECK_EQ(core->cache->idleCycles, idleCycles[i]);
+        }
+        Cache* cache = sim.getCores()[2]->cache;
+        CHECK_EQ(cache->transitions[SHARED][EXCLUSIVE], 1u);
+        CHECK_EQ(cache->transitions[EXCLUSIVE][MODIFIED], 1u);
+        CHECK_EQ(cache->invalidations, 0u);
+        CHECK(!sim.getCores()[2]->parked);
+        CHECK(!sim.getBus().hasWaiters());
+    }
+}
+
+int main() {
+    testParkedUpgradePromoted();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,30 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#pragma once
+#include <iostream>
+
+// Minimal assertions for the test programs under tests/: a failed CHECK is
+// reported with its location and counted, and main returns CHECK_RESULT().
+static int checkFailures = 0;
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+            checkFailures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                          \
+    do {                                                                        \
+        if (!((a) == (b))) {                                                    \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #a ", " #b ") failed: " \
+                      << (a) << " != " << (b) << std::endl;                     \
+            checkFailures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_RESULT() (checkFailures == 0 ? 0 : 1)
+
+#endif // CHECK_H
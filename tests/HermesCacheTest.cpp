@@ -0,0 +1,146 @@
+#include "HermesCache.hh"
+#include "Simulator.hh"
+#include "Check.hh"
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    // The accesses L1simulate would load for a trace, tagged with their core
+    std::vector<HermesAccess> readTraces(const std::string& baseName) {
+        std::vector<HermesAccess> accesses;
+        for (int i = 0; i < HermesCache::NUM_CORES; i++) {
+            std::string filename = baseName + "_proc" + std::to_string(i) + ".trace";
+            std::ifstream file(filename);
+            CHECK(file.is_open());
+            std::string line;
+            Request req;
+            while (std::getline(file, line)) {
+                if (parseTraceLine(line, filename, req)) {
+                    HermesAccess access = { static_cast<uint8_t>(i), req.isWrite, req.address };
+                    accesses.push_back(access);
+                }
+            }
+        }
+        return accesses;
+    }
+
+    void checkSameStats(const HermesCache& lib, const Simulator& sim) {
+        for (int i = 0; i < HermesCache::NUM_CORES; i++) {
+            HermesCoreStats stats = lib.coreStats(i);
+            const Core* core = sim.getCores()[i];
+            const Cache* cache = core->cache;
+            CHECK_EQ(stats.reads, core->readCount);
+            CHECK_EQ(stats.writes, core->writeCount);
+            CHECK_EQ(stats.executionCycles, core->execycles);
+            CHECK_EQ(stats.idleCycles, cache->idleCycles);
+            CHECK_EQ(stats.readMisses + stats.writeMisses, cache->readMisses + cache->writeMisses);
+            CHECK_EQ(stats.readHits + stats.writeHits, cache->readHits + cache->writeHits);
+            CHECK_EQ(stats.evictions, cache->evictions);
+            CHECK_EQ(stats.writebacks, cache->writeBacks);
+            CHECK_EQ(stats.invalidations, cache->invalidations);
+            CHECK_EQ(stats.trafficBytes, cache->trafficBytes);
+            CHECK_EQ(stats.backInvalidations, cache->backInvalidations);
+            CHECK_EQ(stats.mshrMerges, cache->mshrMerges);
+            if (cache->prefetcher)
+                CHECK_EQ(stats.prefetchesIssued, cache->prefetcher->issued);
+        }
+        HermesBusStats bus = lib.busStats();
+        CHECK_EQ(bus.transactions, sim.getBus().busTransactions);
+        CHECK_EQ(bus.trafficBytes, sim.getBus().trafficBytes);
+
+        HermesL2Stats l2 = lib.l2Stats();
+        CHECK_EQ(l2.enabled, sim.getL2() != nullptr);
+        if (sim.getL2()) {
+            CHECK_EQ(l2.hits, sim.getL2()->hits);
+            CHECK_EQ(l2.misses, sim.getL2()->misses);
+            CHECK_EQ(l2.backInvalidations, sim.getL2()->backInvalidations);
+        }
+    }
+
+    void checkTrace(const std::string& baseName, bool extended) {
+        HermesConfig config;
+        config.s = 1;
+        config.E = 2;
+        config.b = 4;
+        if (extended) {
+            config.protocol = HERMES_MOESI;
+            config.prefetcher = HERMES_PREFETCH_NEXT_LINE;
+            config.mshrs = 2;
+            config.l2s = 0;
+            config.l2E = 4;
+            config.l2b = 5;
+        }
+
+        // What L1simulate does: load the trace files and run them through
+        Simulator sim(config.s, config.E, config.b, extended ? PROTOCOL_MOESI : PROTOCOL_MESI);
+        if (extended) {
+            sim.enablePrefetcher(PREFETCH_NEXT_LINE, config.prefetchDegree, config.prefetchDistance);
+            sim.enableNonBlocking(config.mshrs);
+            CHECK(sim.enableL2(config.l2s, config.l2E, config.l2b, config.l2HitLatency, L2_LRU));
+        }
+        sim.loadTraces(baseName);
+        sim.run();
+
+        std::vector<HermesAccess> accesses = readTraces(baseName);
+
+        // Pushed up front and drained
+        HermesCache drained(config);
+        CHECK(drained.push(accesses));
+        drained.drain();
+        checkSameStats(drained, sim);
+
+        // Pushed up front and stepped a few cycles at a time
+        HermesCache stepped(config);
+        CHECK(stepped.push(accesses));
+        int steps = 0;
+        while (stepped.step(7))
+            steps++;
+        CHECK(steps > 0);
+        checkSameStats(stepped, sim);
+        CHECK_EQ(stepped.busStats().cycle, drained.busStats().cycle);
+    }
+
+    void testMatchesSimulator() {
+        const char* traces[] = { "bonus_tc/app3", "bonus_tc/cachethrashing", "bonus_tc/conflict" };
+        for (const char* trace : traces) {
+            checkTrace(trace, false);
+            checkTrace(trace, true);
+        }
+    }
+
+    void testRejectsBadCore() {
+        HermesCache lib;
+        HermesAccess accesses[] = { { 0, false, 0x0 }, { HermesCache::NUM_CORES, false, 0x40 } };
+        CHECK(!lib.push(accesses, 2));
+        lib.drain();
+        CHECK_EQ(lib.coreStats(0).reads, 0u);
+        CHECK_EQ(lib.busStats().transactions, 0u);
+    }
+
+    void testRejectsBadPrefetch() {
+        HermesConfig config;
+        config.prefetcher = HERMES_PREFETCH_NEXT_LINE;
+        config.prefetchDistance = -3;
+        bool thrown = false;
+        try {
+            HermesCache lib(config);
+        } catch (const std::invalid_argument&) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+
+    void testVersion() {
+        CHECK_EQ(hermesCacheVersion(), HERMESCACHE_VERSION);
+    }
+}
+
+int main() {
+    testMatchesSimulator();
+    testRejectsBadCore();
+    testRejectsBadPrefetch();
+    testVersion();
+    return CHECK_RESULT();
+}
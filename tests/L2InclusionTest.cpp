@@ -0,0 +1,139 @@
+#include "Simulator.hh"
+#include "Check.hh"
+#include <cstdint>
+
+namespace {
+    // Number of valid L1 lines, over every core, whose block the L2 lacks
+    int missingFromL2(const Simulator& sim) {
+        int missing = 0;
+        for (Core* core : sim.getCores()) {
+            const Cache* l1 = core->cache;
+            for (size_t i = 0; i < l1->lines.size(); i++) {
+                const CacheLine& line = l1->lines[i];
+                if (!line.valid || line.state == INVALID)
+                    continue;
+                uint32_t setIndex = static_cast<uint32_t>(i / l1->E);
+                uint32_t address = (line.tag << (l1->s + l1->b)) | (setIndex << l1->b);
+                if (!sim.getL2()->contains(address))
+                    missing++;
+            }
+        }
+        return missing;
+    }
+
+    void checkInclusion(ProtocolKind protocol, L2Replacement replacement, bool nonBlocking) {
+        // 16 lines of 32 bytes per L1 behind a 16-line L2 of 64-byte blocks: the
+        // L2 holds barely more than one L1, so its victims are usually cached above
+        Simulator sim(3, 2, 5, protocol);
+        CHECK(sim.enableL2(2, 4, 6, 10, replacement));
+        if (nonBlocking) {
+            sim.enableNonBlocking(4);
+            sim.enablePrefetcher(PREFETCH_NEXT_LINE, 2, 1);
+        }
+
+        uint32_t rng = 99;
+        for (int batch = 0; batch < 50; batch++) {
+            for (int i = 0; i < 40; i++) {
+                for (int core = 0; core < 4; core++) {
+                    rng = rng * 1103515245u + 12345u;
+                    uint32_t address = ((rng >> 8) % 256) << 4;     // 4 KB shared working set
+                    sim.pushAccess(core, (rng >> 28) < 5, address);
+                }
+            }
+            // The invariant must hold after every cycle, not only at the end
+            while (sim.step())
+                CHECK_EQ(missingFromL2(sim), 0);
+        }
+
+        const L2Cache* l2 = sim.getL2();
+        CHECK(l2->backInvalidations > 0);
+        CHECK(l2->writebacks > 0);
+        CHECK_EQ(l2->inclusionViolations, 0u);
+
+        uint64_t backInvalidations = 0, inclusionMisses = 0;
+        for (Core* core : sim.getCores()) {
+            const Cache* l1 = core->cache;
+            backInvalidations += l1->backInvalidations;
+            inclusionMisses += l1->inclusionMisses;
+            CHECK_EQ(l1->compulsoryMisses + l1->capacityMisses + l1->conflictMisses +
+                     l1->coherenceMisses + l1->inclusionMisses, l1->readMisses + l1->writeMisses);
+        }
+        CHECK_EQ(backInvalidations, l2->backInvalidations);
+        CHECK(inclusionMisses > 0);
+    }
+
+    void testInclusion() {
+        const ProtocolKind protocols[] = { PROTOCOL_MESI, PROTOCOL_MOESI, PROTOCOL_MESIF };
+        const L2Replacement replacements[] = { L2_LRU, L2_RANDOM };
+        for (ProtocolKind protocol : protocols) {
+            for (L2Replacement replacement : replacements) {
+                checkInclusion(protocol, replacement, false);
+                checkInclusion(protocol, replacement, true);
+            }
+        }
+    }
+
+    void testDirtyBackInvalidation() {
+        // A direct-mapped one-set L2 of 64-byte blocks: core 0 dirties X, and a
+        // read of Y by core 1 evicts X from the L2, taking core 0's copy with it.
+        // The dirty data crosses the bus and the L2 victim goes to memory.
+        const uint32_t X = 0x000;
+        const uint32_t Y = 0x040;
+        Simulator sim(1, 2, 5, PROTOCOL_MESI);
+        CHECK(sim.enableL2(0, 1, 6, 10, L2_LRU));
+        sim.pushAccess(0, true, X);
+        sim.run();
+        uint64_t trafficBefore = sim.getBus().trafficBytes;
+        sim.pushAccess(1, false, Y);
+        sim.run();
+
+        Cache* l1 = sim.getCores()[0]->cache;
+        CHECK(l1->findLine(0, X >> 6) == nullptr);
+        CHECK_EQ(l1->backInvalidations, 1u);
+        CHECK_EQ(l1->writeBacks, 1u);
+        CHECK_EQ(l1->transitions[MODIFIED][INVALID], 1u);
+        CHECK_EQ(sim.getL2()->writebacks, 1u);
+        // The fill of Y plus the written-back X
+        CHECK_EQ(sim.getBus().trafficBytes - trafficBefore, 64u);
+
+        // Core 0 missing on X again is an inclusion miss, not a capacity one
+        sim.pushAccess(0, false, X);
+        sim.run();
+        CHECK_EQ(l1->inclusionMisses, 1u);
+        CHECK_EQ(l1->capacityMisses, 0u);
+    }
+
+    void testPrefetchKeepsL1Blocks() {
+        // A two-way, one-set L2 with blocks as large as the L1's. Core 0 dirties X,
+        // and core 1's read of Y fills the L2. The next-line prefetch of Z that
+        // follows would need the L2 to evict X, still MODIFIED in core 0, so it
+        // is dropped rather than taking a live line away from a demand user.
+        const uint32_t X = 0x000;
+        const uint32_t Y = 0x040;
+        Simulator sim(1, 2, 6, PROTOCOL_MESI);
+        CHECK(sim.enableL2(0, 2, 6, 10, L2_LRU));
+        sim.enablePrefetcher(PREFETCH_NEXT_LINE, 1, 1);
+        sim.pushAccess(0, true, X);
+        sim.run();
+        sim.pushAccess(1, false, Y);
+        sim.run();
+        for (int i = 0; i < 20; i++)
+            sim.pushAccess(1, false, Y);
+        sim.run();
+
+        Cache* owner = sim.getCores()[0]->cache;
+        CacheLine* line = owner->findLine(0, X >> 7);
+        CHECK(line != nullptr && line->state == MODIFIED);
+        CHECK_EQ(owner->backInvalidations, 0u);
+        CHECK_EQ(sim.getL2()->backInvalidations, 0u);
+        CHECK(sim.getCores()[1]->cache->prefetcher->dropped > 0);
+        CHECK_EQ(missingFromL2(sim), 0);
+    }
+}
+
+int main() {
+    testInclusion();
+    testDirtyBackInvalidation();
+    testPrefetchKeepsL1Blocks();
+    return CHECK_RESULT();
+}
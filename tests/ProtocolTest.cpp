@@ -0,0 +1,86 @@
+#include "Simulator.hh"
+#include "Check.hh"
+#include <cstdint>
+
+namespace {
+    // Direct-mapped, two sets of 32-byte blocks: X and Y share set 0
+    const uint32_t X = 0x000;
+    const uint32_t Y = 0x040;
+
+    // Performs one access on its own, so accesses from different cores never race
+    void perform(Simulator& sim, int core, bool isWrite, uint32_t address) {
+        sim.pushAccess(core, isWrite, address);
+        sim.run();
+    }
+
+    // State of X in a core's cache, INVALID if absent
+    CacheState stateOfX(Simulator& sim, int core) {
+        CacheLine* line = sim.getCores()[core]->cache->findLine(0, X >> 6);
+        return line ? line->state : INVALID;
+    }
+
+    void testMoesiSharerLeavesOwner() {
+        // Core 0 owns a dirty X that cores 1 and 2 share. When core 1 evicts its
+        // copy, core 2 is not the only holder and must stay SHARED, not EXCLUSIVE.
+        Simulator sim(1, 1, 5, PROTOCOL_MOESI);
+        perform(sim, 0, true, X);
+        perform(sim, 1, false, X);
+        perform(sim, 2, false, X);
+        CHECK_EQ(stateOfX(sim, 0), OWNED);
+        CHECK_EQ(stateOfX(sim, 1), SHARED);
+        CHECK_EQ(stateOfX(sim, 2), SHARED);
+
+        perform(sim, 1, false, Y);
+        CHECK_EQ(stateOfX(sim, 0), OWNED);
+        CHECK_EQ(stateOfX(sim, 1), INVALID);
+        CHECK_EQ(stateOfX(sim, 2), SHARED);
+
+        // A write by core 2 now goes to the bus and takes the owner's copy
+        perform(sim, 2, true, X);
+        CHECK_EQ(stateOfX(sim, 0), INVALID);
+        CHECK_EQ(stateOfX(sim, 2), MODIFIED);
+        CHECK_EQ(sim.getCores()[0]->cache->transitions[OWNED][INVALID], 1u);
+    }
+
+    void testMoesiLastSharerBesideOwner() {
+        // With only the owner left beside it, an evicted sharer changes nothing
+        Simulator sim(1, 1, 5, PROTOCOL_MOESI);
+        perform(sim, 0, true, X);
+        perform(sim, 1, false, X);
+        perform(sim, 1, false, Y);
+        CHECK_EQ(stateOfX(sim, 0), OWNED);
+        CHECK_EQ(stateOfX(sim, 1), INVALID);
+    }
+
+    void testMesiLoneSharerPromoted() {
+        // Two clean sharers: when one leaves, the other becomes EXCLUSIVE
+        Simulator sim(1, 1, 5, PROTOCOL_MESI);
+        perform(sim, 0, false, X);
+        perform(sim, 1, false, X);
+        CHECK_EQ(stateOfX(sim, 0), SHARED);
+        CHECK_EQ(stateOfX(sim, 1), SHARED);
+        perform(sim, 1, false, Y);
+        CHECK_EQ(stateOfX(sim, 0), EXCLUSIVE);
+    }
+
+    void testMesifForwarderPromoted() {
+        // The forwarder left alone also becomes EXCLUSIVE
+        Simulator sim(1, 1, 5, PROTOCOL_MESIF);
+        perform(sim, 0, false, X);
+        perform(sim, 1, false, X);
+        perform(sim, 2, false, X);
+        perform(sim, 1, false, Y);
+        CHECK_EQ(stateOfX(sim, 0), SHARED);
+        CHECK_EQ(stateOfX(sim, 2), FORWARD);
+        perform(sim, 0, false, Y);
+        CHECK_EQ(stateOfX(sim, 2), EXCLUSIVE);
+    }
+}
+
+int main() {
+    testMoesiSharerLeavesOwner();
+    testMoesiLastSharerBesideOwner();
+    testMesiLoneSharerPromoted();
+    testMesifForwarderPromoted();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,113 @@
+#include "ReuseDistance.hh"
+#include "Check.hh"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+    // Bucket index used by ReuseDistance: 0 for distance 0, k for [2^(k-1), 2^k - 1]
+    size_t bucketOf(uint64_t distance) {
+        size_t bucket = 0;
+        while (distance > 0) {
+            distance >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    // Reference model: an explicit LRU stack, where the distance is the depth of the block
+    struct NaiveReuse {
+        std::vector<uint32_t> stack;    // Most recently used last
+        std::vector<uint64_t> histogram;
+        uint64_t cold;
+
+        NaiveReuse() : cold(0) {}
+
+        void access(uint32_t block) {
+            std::vector<uint32_t>::iterator it = std::find(stack.begin(), stack.end(), block);
+            if (it == stack.end()) {
+                cold++;
+            } else {
+                size_t bucket = bucketOf(stack.end() - it - 1);
+                if (histogram.size() <= bucket)
+                    histogram.resize(bucket + 1, 0);
+                histogram[bucket]++;
+                stack.erase(it);
+            }
+            stack.push_back(block);
+        }
+    };
+
+    uint64_t bucket(const ReuseDistance& reuse, size_t k) {
+        return k < reuse.histogram.size() ? reuse.histogram[k] : 0;
+    }
+
+    void testExactDistances() {
+        // A B C A B A A with 32-byte blocks: distances 2, 2, 1, 0
+        ReuseDistance reuse(5);
+        const uint32_t trace[] = { 0x000, 0x020, 0x040, 0x01f, 0x030, 0x000, 0x004 };
+        for (uint32_t address : trace)
+            reuse.access(address);
+        CHECK_EQ(reuse.totalAccesses, 7u);
+        CHECK_EQ(reuse.coldAccesses, 3u);
+        CHECK_EQ(bucket(reuse, 0), 1u);     // distance 0
+        CHECK_EQ(bucket(reuse, 1), 1u);     // distance 1
+        CHECK_EQ(bucket(reuse, 2), 2u);     // distances 2 and 3
+    }
+
+    void testAcrossCompactionAndGrowth() {
+        // Cycling through 2^k blocks puts every reuse at distance 2^k - 1, the top
+        // of bucket k, so an off-by-one anywhere lands in bucket k + 1. 32768
+        // blocks fill the initial 65536-slot time axis and force compactions;
+        // 65536 blocks also force it to grow.
+        const uint32_t sizes[] = { 32768, 65536 };
+        for (uint32_t blocks : sizes) {
+            ReuseDistance reuse(0);
+            for (int pass = 0; pass < 4; pass++) {
+                for (uint32_t block = 0; block < blocks; block++)
+                    reuse.access(block);
+            }
+            size_t k = bucketOf(blocks - 1);
+            CHECK_EQ(reuse.coldAccesses, blocks);
+            CHECK_EQ(reuse.histogram.size(), k + 1);
+            CHECK_EQ(bucket(reuse, k), 3u * blocks);
+        }
+    }
+
+    void testAgainstLruStack() {
+        // Random accesses over a small working set compact the time axis many
+        // times; every bucket must match the explicit stack
+        ReuseDistance reuse(6);
+        NaiveReuse naive;
+        uint32_t rng = 12345;
+        for (int i = 0; i < 300000; i++) {
+            rng = rng * 1103515245u + 12345u;
+            uint32_t block = (rng >> 8) % ((i / 50000 + 1) * 300);
+            reuse.access(block << 6 | (rng & 63));
+            naive.access(block);
+        }
+        CHECK_EQ(reuse.coldAccesses, naive.cold);
+        CHECK_EQ(reuse.histogram.size(), naive.histogram.size());
+        for (size_t k = 0; k < naive.histogram.size(); k++)
+            CHECK_EQ(bucket(reuse, k), naive.histogram[k]);
+    }
+
+    void testMerge() {
+        ReuseDistance a(0), b(0);
+        a.access(1); a.access(1);
+        b.access(1); b.access(2); b.access(3); b.access(1);
+        a.merge(b);
+        CHECK_EQ(a.totalAccesses, 6u);
+        CHECK_EQ(a.coldAccesses, 4u);
+        CHECK_EQ(bucket(a, 0), 1u);
+        CHECK_EQ(bucket(a, 2), 1u);
+    }
+}
+
+int main() {
+    testExactDistances();
+    testAcrossCompactionAndGrowth();
+    testAgainstLruStack();
+    testMerge();
+    return CHECK_RESULT();
+}
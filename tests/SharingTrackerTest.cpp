@@ -0,0 +1,104 @@
+#include "SharingTracker.hh"
+#include "Check.hh"
+#include <cstdint>
+
+namespace {
+    // 32-byte blocks; offsets 0x00 and 0x10 of block 0x100 never overlap
+    const uint32_t A = 0x100;
+    const uint32_t B = 0x110;
+
+    // Counts of (true, false) events after a single classification
+    void checkEvent(SharingTracker& tracker, uint64_t trueEvents, uint64_t falseEvents) {
+        CHECK_EQ(tracker.trueSharing, trueEvents);
+        CHECK_EQ(tracker.falseSharing, falseEvents);
+    }
+
+    void testWrites() {
+        // A write next to a holder that only read other bytes is false sharing
+        SharingTracker readOther(5);
+        readOther.access(0, A, false);
+        readOther.coherenceEvent(1, B, true, 1u << 0);
+        checkEvent(readOther, 0, 1);
+
+        // ... and true sharing once the holder read the written bytes
+        SharingTracker readSame(5);
+        readSame.access(0, A, false);
+        readSame.coherenceEvent(1, A, true, 1u << 0);
+        checkEvent(readSame, 1, 0);
+
+        SharingTracker wroteOther(5);
+        wroteOther.access(0, A, true);
+        wroteOther.coherenceEvent(1, B, true, 1u << 0);
+        checkEvent(wroteOther, 0, 1);
+
+        // A holder that never touched the block does not count
+        SharingTracker untouched(5);
+        untouched.access(0, A, false);
+        untouched.coherenceEvent(1, B, true, 1u << 2);
+        checkEvent(untouched, 0, 0);
+    }
+
+    void testReads() {
+        SharingTracker wroteSame(5);
+        wroteSame.access(0, A, true);
+        wroteSame.coherenceEvent(1, A, false, 1u << 0);
+        checkEvent(wroteSame, 1, 0);
+
+        SharingTracker wroteOther(5);
+        wroteOther.access(0, A, true);
+        wroteOther.coherenceEvent(1, B, false, 1u << 0);
+        checkEvent(wroteOther, 0, 1);
+
+        // Reading beside readers is clean read sharing, neither true nor false
+        SharingTracker readOnly(5);
+        readOnly.access(0, A, false);
+        readOnly.coherenceEvent(1, A, false, 1u << 0);
+        checkEvent(readOnly, 0, 0);
+    }
+
+    void testEpochs() {
+        // Each event starts a new epoch: the holder's earlier use is forgotten
+        SharingTracker tracker(5);
+        tracker.access(0, A, true);
+        tracker.coherenceEvent(1, A, false, 1u << 0);
+        tracker.access(1, A, false);
+        tracker.coherenceEvent(2, B, true, (1u << 0) | (1u << 1));
+        checkEvent(tracker, 1, 1);
+
+        // Including an event by the block's only user so far
+        SharingTracker sole(5);
+        sole.access(0, A, true);
+        sole.coherenceEvent(0, A, true, 1u << 1);
+        sole.coherenceEvent(1, A, false, 1u << 0);
+        checkEvent(sole, 0, 0);
+    }
+
+    void testPrivateBlocksStayCompact() {
+        // Blocks only ever touched by one core carry no per-core table
+        SharingTracker tracker(5);
+        for (uint32_t block = 0; block < 1000; block++) {
+            tracker.access(block % 4, block << 5, block % 3 == 0);
+            tracker.access(block % 4, (block << 5) | 8, false);
+        }
+        CHECK_EQ(tracker.sharedBlocks(), 0u);
+
+        // The second core to touch a block brings the table in, keeping the first core's masks
+        tracker.access(1, 0x000, false);
+        CHECK_EQ(tracker.sharedBlocks(), 1u);
+        tracker.coherenceEvent(2, 0x000, false, (1u << 0) | (1u << 1));
+        checkEvent(tracker, 1, 0);
+
+        // So does the first coherence event a second core causes
+        tracker.coherenceEvent(2, 0x030, true, 1u << 1);
+        CHECK_EQ(tracker.sharedBlocks(), 2u);
+        checkEvent(tracker, 1, 1);
+    }
+}
+
+int main() {
+    testWrites();
+    testReads();
+    testEpochs();
+    testPrivateBlocksStayCompact();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,89 @@
+#include "TagMatch.hh"
+#include "Cache.hh"
+#include "Check.hh"
+#include <vector>
+#include <cstdint>
+
+namespace {
+    // A TAG_ALIGN-aligned row of ways tags, all EMPTY_TAG to begin with
+    struct TagRow {
+        std::vector<uint32_t> storage;
+        uint32_t* tags;
+
+        explicit TagRow(int ways) : storage(ways + TAG_ALIGN / sizeof(uint32_t), EMPTY_TAG) {
+            uintptr_t base = reinterpret_cast<uintptr_t>(storage.data());
+            tags = reinterpret_cast<uint32_t*>((base + TAG_ALIGN - 1) & ~static_cast<uintptr_t>(TAG_ALIGN - 1));
+        }
+    };
+
+    void checkKernel(TagMatchFn kernel) {
+        TagMatchFn scalar = tagMatchKernel(TAG_MATCH_SCALAR);
+        uint32_t rng = 7;
+
+        for (int ways = TAG_GROUP; ways <= 4 * TAG_GROUP; ways += TAG_GROUP) {
+            TagRow row(ways);
+            for (int i = 0; i < ways; i++)
+                row.tags[i] = 0x1000 + i;
+
+            // Every way, including the first and last of the row
+            for (int i = 0; i < ways; i++) {
+                CHECK_EQ(kernel(row.tags, ways, 0x1000 + i), i);
+                CHECK_EQ(kernel(row.tags, ways, 0x1000 + i), scalar(row.tags, ways, 0x1000 + i));
+            }
+            // No match, and a tag that only differs in its top bit
+            CHECK_EQ(kernel(row.tags, ways, 0x0fff), -1);
+            CHECK_EQ(kernel(row.tags, ways, 0x80001000u), -1);
+
+            // Duplicates report the first way, as the scalar loop does
+            row.tags[ways - 1] = 0x1000 + ways / 2;
+            CHECK_EQ(kernel(row.tags, ways, 0x1000 + ways / 2), ways / 2);
+
+            // Random rows with repeated values
+            for (int trial = 0; trial < 2000; trial++) {
+                for (int i = 0; i < ways; i++) {
+                    rng = rng * 1103515245u + 12345u;
+                    row.tags[i] = (rng >> 16) % (2 * ways);
+                }
+                rng = rng * 1103515245u + 12345u;
+                uint32_t tag = (rng >> 16) % (2 * ways);
+                CHECK_EQ(kernel(row.tags, ways, tag), scalar(row.tags, ways, tag));
+            }
+        }
+    }
+
+    void testKernels() {
+        CHECK(tagMatchKernel(TAG_MATCH_SCALAR) != nullptr);
+        const TagMatchKernel kernels[] = { TAG_MATCH_SCALAR, TAG_MATCH_SSE2, TAG_MATCH_AVX2 };
+        for (TagMatchKernel kind : kernels) {
+            TagMatchFn kernel = tagMatchKernel(kind);
+            if (kernel != nullptr)
+                checkKernel(kernel);
+            else
+                std::cerr << "TagMatchTest: kernel " << kind << " unavailable, skipped" << std::endl;
+        }
+    }
+
+    void testCacheLookup() {
+        // Six ways pad each row to eight: the padding must never match, and the
+        // last real way must be found
+        Cache cache(2, 6, 4);
+        const uint32_t set = 3;
+        for (int w = 0; w < 6; w++)
+            cache.insertLine(set, 0x0fffff00u + w, 0, false, SHARED);
+        CHECK_EQ(cache.findWay(set, 0x0fffff05u), 5);
+        CHECK_EQ(cache.findWay(set, 0x0fffff00u), 0);
+        CHECK_EQ(cache.findWay(set, 0x0fffff06u), -1);
+        CHECK_EQ(cache.findWay(set - 1, 0x0fffff05u), -1);
+        CHECK(cache.findLine(set, 0x0fffff05u) != nullptr);
+
+        // An invalidated line is no longer found
+        cache.setState(*cache.findLine(set, 0x0fffff05u), INVALID);
+        CHECK(cache.findLine(set, 0x0fffff05u) == nullptr);
+    }
+}
+
+int main() {
+    testKernels();
+    testCacheLookup();
+    return CHECK_RESULT();
+}
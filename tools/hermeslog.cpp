@@ -0,0 +1,148 @@
+// hermeslog: summarize or filter a binary coherence event log written by L1simulate -l
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include "EventLog.hh"
+
+namespace {
+
+const char* TYPE_NAMES[EV_TYPE_COUNT] = { "BusRd", "BusRdX", "BusUpgrade", "Writeback", "Eviction", "Prefetch", "BackInvalidate" };
+const char* STATE_NAMES[] = { "M", "E", "S", "I", "O", "F" };
+
+const char* stateName(uint8_t state) {
+    return state < 6 ? STATE_NAMES[state] : "?";
+}
+
+void printHelp(char* programName) {
+    std::cout << "Usage: " << programName << " <logfile> [-c <core>] [-e <type>] [-a <address>] [-p] [-n <top>]\n"
+              << "  -c  Only events of this core\n"
+              << "  -e  Only events of this type (";
+    for (int t = 0; t < EV_TYPE_COUNT; t++)
+        std::cout << (t ? ", " : "") << TYPE_NAMES[t];
+    std::cout << ")\n"
+              << "  -a  Only events on the block containing this hex address\n"
+              << "  -p  Print matching records instead of the summary\n"
+              << "  -n  Number of hottest blocks in the summary (default 10)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printHelp(argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    std::string filename = argv[1];
+    int coreFilter = -1;
+    int typeFilter = -1;
+    bool haveAddress = false;
+    uint32_t addressFilter = 0;
+    bool printRecords = false;
+    size_t top = 10;
+    
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-c" && i + 1 < argc) {
+            coreFilter = std::stoi(argv[++i]);
+        } else if (arg == "-e" && i + 1 < argc) {
+            std::string name = argv[++i];
+            for (int t = 0; t < EV_TYPE_COUNT; t++) {
+                if (name == TYPE_NAMES[t]) typeFilter = t;
+            }
+            if (typeFilter < 0) {
+                std::cerr << "Unknown event type: " << name << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "-a" && i + 1 < argc) {
+            addressFilter = std::stoul(argv[++i], nullptr, 16);
+            haveAddress = true;
+        } else if (arg == "-p") {
+            printRecords = true;
+        } else if (arg == "-n" && i + 1 < argc) {
+            top = std::stoul(argv[++i]);
+        } else if (arg == "-h") {
+            printHelp(argv[0]);
+            return EXIT_SUCCESS;
+        }
+    }
+    
+    std::ifstream fin(filename, std::ios::binary);
+    EventLogHeader header;
+    if (!fin.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, "HCEVLOG1", 8) != 0 ||
+        header.recordSize != sizeof(EventRecord)) {
+        std::cerr << "Not a HermesCache event log: " << filename << std::endl;
+        return EXIT_FAILURE;
+    }
+    uint32_t blockFilter = addressFilter >> header.blockBits;
+    
+    uint64_t total = 0;
+    uint64_t counts[256][EV_TYPE_COUNT] = {};
+    std::unordered_map<uint32_t, uint64_t> perBlock;
+    
+    std::vector<EventRecord> chunk(1 << 16);
+    bool truncated = false;
+    while (fin) {
+        fin.read(reinterpret_cast<char*>(chunk.data()), chunk.size() * sizeof(EventRecord));
+        size_t n = fin.gcount() / sizeof(EventRecord);
+        truncated = truncated || fin.gcount() % sizeof(EventRecord) != 0;
+        for (size_t i = 0; i < n; i++) {
+            const EventRecord& r = chunk[i];
+            if (coreFilter >= 0 && r.core != coreFilter) continue;
+            if (typeFilter >= 0 && r.type != typeFilter) continue;
+            if (haveAddress && r.block != blockFilter) continue;
+            if (r.type >= EV_TYPE_COUNT) continue;
+            
+            total++;
+            if (printRecords) {
+                std::cout << r.cycle << " core " << int(r.core) << " " << TYPE_NAMES[r.type]
+                          << " 0x" << std::hex << (uint64_t(r.block) << header.blockBits) << std::dec
+                          << " " << stateName(r.priorState) << "->" << stateName(r.newState);
+                if (r.supplier >= 0)
+                    std::cout << " from core " << int(r.supplier);
+                std::cout << "\n";
+            } else {
+                counts[r.core][r.type]++;
+                perBlock[r.block]++;
+            }
+        }
+    }
+    // A partial record means the writer ran out of space or was interrupted
+    if (truncated)
+        std::cerr << "Warning: " << filename << " ends in a partial record; the log is incomplete" << std::endl;
+    if (printRecords)
+        return EXIT_SUCCESS;
+    
+    std::cout << "Events: " << total << std::endl;
+    for (int core = 0; core < 256; core++) {
+        uint64_t sum = 0;
+        for (int t = 0; t < EV_TYPE_COUNT; t++) sum += counts[core][t];
+        if (sum == 0) continue;
+        std::cout << "Core " << core << ":";
+        for (int t = 0; t < EV_TYPE_COUNT; t++)
+            std::cout << " " << TYPE_NAMES[t] << "=" << counts[core][t];
+        std::cout << std::endl;
+    }
+    
+    std::vector<std::pair<uint64_t, uint32_t> > hottest;
+    for (const auto& entry : perBlock)
+        hottest.push_back(std::make_pair(entry.second, entry.first));
+    size_t shown = std::min(top, hottest.size());
+    std::partial_sort(hottest.begin(), hottest.begin() + shown, hottest.end(),
+                      [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) {
+                          return a.first > b.first || (a.first == b.first && a.second < b.second);
+                      });
+    std::cout << "Hottest blocks:" << std::endl;
+    for (size_t i = 0; i < shown; i++) {
+        std::cout << "  0x" << std::hex << (uint64_t(hottest[i].second) << header.blockBits) << std::dec
+                  << ": " << hottest[i].first << std::endl;
+    }
+    return EXIT_SUCCESS;
+}